@@ -2,9 +2,58 @@
 #include <string>
 #include <sstream>
 #include <unordered_map>
+#include <map>
 #include <vector>
 #include <stack>
+#include <deque>
+#include <memory>
+#include <fstream>
+#include <stdexcept>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <list>
 #include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <filesystem>
+#include <random>
+
+#ifndef _WIN32
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <netdb.h>
+#include <poll.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <csignal>
+#include <cerrno>
+#endif
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/un.h>
+#endif
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE4_1__)
+#include <smmintrin.h>
+#endif
 
 enum InstructionType {
     NONE, // Default or uninitialized state
@@ -27,10 +76,227 @@ enum InstructionType {
     CALL,   // call a subroutine
     RET,    // return instruction pointer to next instruction after CALL instruction
     MSG,    // stores the output of the program
-    END     // end program and return stored value
+    END,    // end program and return stored value
+    AND,    // bitwise AND of register value and constant or value of another register
+    OR,     // bitwise OR of register value and constant or value of another register
+    XOR,    // bitwise XOR of register value and constant or value of another register
+    NOT,    // invert all bits of register value
+    SHL,    // shift register value left by constant or value of another register (the count is taken modulo 32)
+    SHR,    // shift register value right filling with zeros (the count is taken modulo 32)
+    MOD,    // remainder of dividing register value by constant or another register value, it has the sign of the register value
+    // the following instructions set the result of CMP as if the register was compared to 0
+    LOOP,   // decrease register value by one and jump to the label if it is not 0
+    JNZ,    // jump to the label if register value is not 0
+    JZ,     // jump to the label if register value is 0
+    // conditional moves (copy value to the register, constant or value of a register, if result of CMP ...)
+    CMOVNE, // ... is not equal
+    CMOVE,  // ... is equal
+    CMOVGE, // ... is greater or equal
+    CMOVG,  // ... is greater
+    CMOVLE, // ... is less or equal
+    CMOVL,  // ... is less
+    JTAB,   // jump to the label at the index given by the register value, continue with the next instruction if there is none
+    // linear memory of ints (see the .memory and .data directives), addresses are constants or register values plus an optional index
+    LOAD,   // copy the value at the address to the register
+    STORE,  // copy constant or value of a register to the address
+    MEMSET, // set a number of ints starting at the address to constant or value of a register
+    MEMCPY, // copy a number of ints from the second address to the first one, the ranges may overlap
+    // data stack, separate from the positions saved by CALL
+    PUSH,   // push constants or register values in the order of the arguments
+    POP,    // pop values into the registers in the reverse order of the arguments, so "pop" with the arguments of "push" restores them
+    // vector registers v0 ... v15 of 8 ints (lanes) each, all lanes are 0 at the start of a run
+    VMOV,   // copy a vector register
+    VADD,   // add lanes of another vector register
+    VSUB,   // subtract lanes of another vector register
+    VMUL,   // multiply by lanes of another vector register
+    VMIN,   // keep the smaller of each pair of lanes
+    VMAX,   // keep the greater of each pair of lanes
+    VCMPEQ, // set lanes to -1 where they are equal to lanes of another vector register, 0 elsewhere
+    VCMPGT, // set lanes to -1 where they are greater than lanes of another vector register, 0 elsewhere
+    VSET,   // set all lanes to constant or value of a register
+    VHSUM,  // set the register to the sum of the lanes of a vector register
+    VHMIN,  // set the register to the smallest lane of a vector register
+    VHMAX,  // set the register to the greatest lane of a vector register
+    VLOAD,  // copy 8 ints starting at the address to a vector register
+    VSTORE, // copy a vector register to 8 ints starting at the address
+    SYSCALL, // set the register to the result of a native function (see NativeFunctions) called with constants or register values
+    // tasks run in parallel with their own registers, memory and stacks; channels are declared by the .channel directive
+    SPAWN,  // start a task at the label with copies of the registers and the memory, the register gets the id of the task (also in the task)
+    JOIN,   // wait until the task whose id is the register value has finished
+    SEND,   // append constant or value of a register to a channel, wait while the channel is full
+    RECV,   // move the oldest value of a channel to the register, wait while the channel is empty
+    // ops created by Bytecode::optimize(), they have no mnemonic
+    DECJNE  // DEC, CMP and JNE of the same register fused into one op
     // comments are defined by the ';' symbol
 };
 
+// result of CMP: negative, 0 or positive as the first value is less than, equal to or greater than the second one
+// the difference of the values would have the wrong sign when it overflows, e.g. for 19 and the smallest int
+int compareValues(int a, int b)
+{
+    return (a > b) - (a < b);
+}
+
+// arithmetic of registers wraps around on overflow, like the lanes of vector registers
+// it is done on unsigned ints, whose overflow is defined, so both engines agree regardless of the compiler
+int wrapAdd(int a, int b)
+{
+    return static_cast<int>(static_cast<uint32_t>(a) + static_cast<uint32_t>(b));
+}
+
+int wrapSub(int a, int b)
+{
+    return static_cast<int>(static_cast<uint32_t>(a) - static_cast<uint32_t>(b));
+}
+
+int wrapMul(int a, int b)
+{
+    return static_cast<int>(static_cast<uint32_t>(a) * static_cast<uint32_t>(b));
+}
+
+// a native C++ function called by SYSCALL, it gets the values of the arguments and returns the new value of the register
+// like instructions, it reports errors by throwing a string
+typedef int (*NativeFunction)(const int* args, size_t count);
+
+// native functions which programs call by name, e.g. "syscall c, gcd, a, b"
+// names are bound when a program is linked, so a call is a direct call of the function; functions must be added before programs calling them are compiled
+class NativeFunctions
+{
+private:
+    struct entry {
+        NativeFunction function;
+        int arity;      // number of arguments, -1 if any number from 1 to `maxArguments`
+    };
+
+    static std::mutex registryMutex;
+    static std::unordered_map<std::string, entry> registry;
+public:
+    static const size_t maxArguments = 8;
+
+    // replaces a function of the same name
+    static void add(const std::string& name, NativeFunction function, int arity);
+    // returns nullptr if there is no function of the name
+    static NativeFunction find(const std::string& name, int& arity);
+    // returns names and arities of all functions ordered by name
+    static std::vector<std::pair<std::string, int>> list();
+};
+
+// compiled form of a program produced by Interpreter::compile()
+// labels are resolved to instruction positions and register names to slots, so the program can be executed by BytecodeEngine without any string handling
+// a single instance is read-only after compilation and may be shared by many engines and threads
+struct Bytecode {
+    // an instruction argument: a register slot or a constant
+    struct operand {
+        bool isRegister;
+        int value;
+    };
+    // a part of a message pattern (see MSG)
+    struct messagePart {
+        enum Kind { TEXT, REGISTER, INVALID } kind;
+        std::string text;   // quoted text without apostrophes, or the invalid argument
+        int slot;           // register slot (REGISTER only)
+    };
+    struct op {
+        InstructionType type;
+        operand dst;        // first argument
+        operand src;        // second argument, the value of STORE
+        operand extra;      // index of LOAD and STORE, number of ints of MEMSET and MEMCPY
+        int target;         // position of the label (jumps, CALL and SPAWN), index into `messages` (MSG), `tables` (JTAB), `stackOperands` (PUSH and POP) or `nativeCalls` (SYSCALL), -1 if unresolved
+        int fault;          // index into `faults`; NONE ops always throw it, jumps throw it when taken; -1 if none
+    };
+    // a native function bound by SYSCALL and its arguments
+    struct nativeCall {
+        std::string name;
+        NativeFunction function;
+        std::vector<operand> args;
+    };
+
+    std::vector<op> code;
+    // register names indexed by slot
+    std::vector<std::string> registerNames;
+    // label names and their corresponding positions in `code`
+    std::unordered_map<std::string, size_t> labels;
+    std::vector<std::vector<messagePart>> messages;
+    // positions of the labels of jump tables (see JTAB)
+    std::vector<std::vector<int>> tables;
+    // arguments of PUSH and POP, POP has only registers
+    std::vector<std::vector<operand>> stackOperands;
+    std::vector<nativeCall> nativeCalls;
+    // contents of the linear memory at the start of a run
+    std::vector<int> memory;
+    // the largest memory a program may declare, in ints
+    static const long long maxMemorySize = 1 << 24;
+    // the number of values the data stack can hold (see PUSH)
+    static const size_t maxStackSize = 1 << 16;
+    // the number of nested CALLs, so unbounded recursion fails instead of growing the call stack until memory runs out
+    static const size_t maxCallDepth = 1 << 20;
+    // vector registers are stored one after another, operands of vector ops are their indices
+    static const int vectorRegisters = 16;
+    static const size_t vectorLanes = 8;
+    // capacities of the channels, indexed by the number of the channel (see SEND and RECV)
+    std::vector<int> channels;
+    static const size_t maxChannels = 256;
+    static const int maxChannelCapacity = 1 << 16;
+    // the number of tasks of a run which were spawned but not joined yet (see SPAWN)
+    static const size_t maxTasks = 1024;
+    // errors which are thrown once the faulty instruction is executed
+    std::vector<std::string> faults;
+
+    // returns the slot of a register or -1 if the program does not use it
+    int findRegister(const std::string& name) const;
+
+    // rewrites common sequences of ops into faster fused ops
+    // the rewritten sequences stay in place after the fused op, so positions of labels do not change and jumps into a sequence still work
+    void optimize();
+
+    std::string serialize() const;
+    static Bytecode deserialize(const std::string& data);
+};
+
+// a location where the running program publishes its position, read by the sampling profiler from a signal handler
+// every thread has its own probe; it contains only lock-free atomics, so a signal handler interrupting the thread can read it safely
+struct ExecutionProbe {
+    static constexpr uint32_t maxDepth = 32;
+
+    // position of the executed instruction + 1, 0 if no program is running
+    std::atomic<uint32_t> position;
+    // number of active calls, only the outermost `maxDepth` calls are stored in `frames`
+    std::atomic<uint32_t> depth;
+    // positions of the labels called by active calls
+    std::atomic<uint32_t> frames[maxDepth];
+
+    // defined here, so runs pay only for the stores while the profiler is enabled
+    void enter(size_t instructionPointer)
+    {
+        this->position.store(static_cast<uint32_t>(instructionPointer + 1), std::memory_order_relaxed);
+    }
+    // `depth` is the number of active calls including the new one, callers keep it so the probe never reads its own state
+    void call(size_t target, size_t depth)
+    {
+        if (depth <= ExecutionProbe::maxDepth) this->frames[depth - 1].store(static_cast<uint32_t>(target), std::memory_order_relaxed);
+        // a signal handler must not see the new depth before the frame
+        std::atomic_signal_fence(std::memory_order_release);
+        this->depth.store(static_cast<uint32_t>(depth), std::memory_order_relaxed);
+    }
+    // `depth` is the number of calls which are still active
+    void ret(size_t depth)
+    {
+        this->depth.store(static_cast<uint32_t>(depth), std::memory_order_relaxed);
+    }
+};
+
+// publishes the position of programs run by the current thread while the profiler is enabled
+// the probe is chosen once per run, so programs do not pay for profiling when it is disabled
+class ProbeScope
+{
+private:
+    ExecutionProbe* probe;
+public:
+    ProbeScope();
+    ~ProbeScope();
+    ExecutionProbe* get() const;
+};
+
 class Interpreter
 {
 private:
@@ -51,6 +317,22 @@ private:
     // stores the entire program as a list of instructions (including type and arguments)
     std::vector<Interpreter::instruction> instructions;
 
+    // stores the macros defined by %macro, their invocations are replaced with their bodies while parsing
+    struct macro {
+        std::vector<std::string> params;
+        // lines of the body without comments, "%%name" is a label local to a single invocation
+        std::vector<std::string> body;
+        bool hasLocals;
+        // bodies with parameters replaced by the arguments of previous invocations, indexed by the arguments
+        std::unordered_map<std::string, std::vector<std::string>> expansions;
+    };
+    std::unordered_map<std::string, Interpreter::macro> macros;
+    // number of invocations so far, makes local labels of every invocation unique
+    size_t macroInvocations;
+    // limits of macros invoking macros, so a recursive macro throws an error instead of growing the program forever
+    static constexpr int maxMacroDepth = 64;
+    static constexpr size_t maxExpandedLines = 1 << 20;
+
     // stores the current pattern of message, which is outputted at the end of the program
     // the pattern consists of a sequence of register keys and literal text segments
     // the final message is constructed by replacing keys with corresponding register values and outputting the text exactly as stored
@@ -59,368 +341,7059 @@ private:
     // stores the message returned by the interpreted assembler program
     std::string output;
 
+    // stores the maximum number of instructions the program may execute
+    uint64_t instructionLimit;
+
+    // stores the linear memory, its size and initial contents are set by directives
+    std::vector<int> memory;
+    // stores the values pushed by PUSH
+    std::vector<int> dataStack;
+    // stores the lanes of all vector registers
+    std::vector<int> vectors;
+
+    // stores the capacities of the channels declared by directives and the values waiting in them
+    std::vector<int> channelCapacities;
+    std::vector<std::deque<int>> channels;
+
+    // stores the state of a task while another one is running, the running task uses the members above
+    // tasks run one at a time and switch only when the running one has to wait or has finished, so runs are deterministic
+    struct task {
+        std::unordered_map<std::string, int> regs;
+        int cmpResult;
+        std::vector<int> memory;
+        std::vector<int> dataStack;
+        std::vector<int> vectors;
+        std::vector<std::string> messagePattern;
+        size_t instructionPointer;
+        std::stack<size_t> callStack;
+        uint64_t executedInstructions;
+        bool isFinished;
+        bool isJoined;
+    };
+    // stores all tasks of the run indexed by their ids, the main program is the task 0
+    std::vector<Interpreter::task> tasks;
+
     void initVariables();
 
-    bool isConst(const std::string& str);
-    bool isRegister(const std::string& str);
+    bool isConst(const std::string& str) const;
+    bool isRegister(const std::string& str) const;
+    // returns the index of a vector register name (v0 ... v15) or -1
+    int findVectorRegister(const std::string& str) const;
 
     void parseProgram();
+    void parseDirective(const std::string& name, const std::vector<std::string>& args);
 
     void execute();
 
     void createMessage();
+
+    Bytecode link() const;
+
+    // used by compile() to parse a program without running it
+    Interpreter() = default;
 public:
     Interpreter(const std::string& program);
+    // runs the program with initial register values, runs executing more instructions than the limit throw an error
+    Interpreter(const std::string& program, const std::vector<std::pair<std::string, int>>& registers, uint64_t instructionLimit = UINT64_MAX);
     const std::string& getOutput() const;
+
+    // parses the program and links it into bytecode without running it
+    static Bytecode compile(const std::string& program, bool isOptimized = true);
 };
 
-// init functions
-void Interpreter::initVariables()
+class TraceRecorder;
+class TaskGroup;
+
+// executes compiled programs
+// registers keep their values between runs, so a single engine can run the same bytecode many times with different inputs
+class BytecodeEngine
 {
-    this->regs = {};
-    this->cmpResult = 0;
-    this->subroutines = {};
-    this->instructions = {};
-    this->messagePattern = {};
-    this->output = "-1";
+    friend class TaskGroup;
+private:
+    // why `resume()` returned
+    enum state { FINISHED, BLOCKED, PREEMPTED };
+
+    std::shared_ptr<const Bytecode> bytecode;
+    // register values indexed by slot
+    std::vector<int> regs;
+    // linear memory, set to the initial contents of the bytecode at the start of every run
+    std::vector<int> memory;
+    // values pushed by PUSH, its capacity is kept between runs
+    std::vector<int> dataStack;
+    // lanes of all vector registers, empty if the program does not use them
+    std::vector<int> vectors;
+    std::vector<size_t> callStack;
+    int cmpResult;
+    // index of the message pattern selected by the last executed MSG instruction, -1 if none
+    int message;
+
+    // number of instructions executed by the last run and the maximum allowed number
+    uint64_t executedInstructions;
+    uint64_t instructionLimit;
+
+    // records the control flow of runs, nullptr if disabled
+    TraceRecorder* recorder;
+
+    std::string output;
+
+    // spawned tasks and channels of the current run, nullptr if the program does not use them
+    bool isTaskUsed;
+    std::shared_ptr<TaskGroup> tasks;
+    // 0 if the engine runs the program, otherwise the id of the spawned task it runs
+    int taskId;
+    // position of the next op, kept while a spawned task is suspended
+    size_t instructionPointer;
+
+    // creates the engine of a task spawned by `parent`, which starts at the position with copies of its registers and memory
+    BytecodeEngine(const BytecodeEngine& parent, int taskId, size_t position);
+
+    void execute(bool renderMessage);
+    // runs ops from `instructionPointer` until the task is finished
+    // a spawned task returns early at an op which has to wait or once it has executed `stopAt` instructions, the program waits in place
+    BytecodeEngine::state resume(bool renderMessage, uint64_t stopAt, ExecutionProbe* probe);
+    void createMessage();
+public:
+    BytecodeEngine(std::shared_ptr<const Bytecode> bytecode);
+
+    // runs executing more instructions than the limit throw an error, so a program which never ends can not block its thread
+    void setInstructionLimit(uint64_t limit);
+    uint64_t getExecutedInstructions() const;
+
+    // the recorder must outlive the runs which use it
+    void setRecorder(TraceRecorder* recorder);
+
+    // sets all registers to 0
+    void reset();
+    void setRegister(int slot, int value);
+    int getRegister(int slot) const;
+
+    // runs the program from the first instruction using the current register values
+    // if `renderMessage` is false the output is not created at END (it stays "-1"), so runs which only need final registers do not allocate
+    void run(bool renderMessage = true);
+    const std::string& getOutput() const;
+};
+
+class WorkerPool;
+
+// spawned tasks and channels of a single run of a program (see SPAWN, SEND and RECV)
+// Every task has its own engine. Tasks run in slices on a process-wide worker pool: a task gives up its thread at an op which has to wait,
+// and after `sliceInstructions` instructions if other tasks are ready. The program itself keeps the thread which started the run;
+// while it waits, it runs ready tasks on that thread, so a run makes progress even if all threads of the pool are busy.
+class TaskGroup : public std::enable_shared_from_this<TaskGroup>
+{
+private:
+    enum taskState { READY, RUNNING, BLOCKED, FINISHED };
+    struct task {
+        // released once the task has finished
+        std::unique_ptr<BytecodeEngine> engine;
+        taskState state;
+        // set if the task was woken while it was still running, so it is resumed instead of blocked
+        bool isWoken;
+        bool isJoined;
+        // tasks waiting for this one to finish
+        std::vector<int> joiners;
+    };
+    struct channel {
+        std::deque<int> values;
+        size_t capacity;
+        // tasks waiting to send or receive, all of them are woken by a change of the channel
+        std::vector<int> waiting;
+    };
+
+    std::mutex mutex;
+    // the program waits on it for changes of channels and tasks
+    std::condition_variable condition;
+    bool isProgramWaiting;
+    // indexed by the id of the task - 1
+    std::vector<TaskGroup::task> tasks;
+    std::vector<TaskGroup::channel> channels;
+    std::deque<int> ready;
+    // number of slices which are being run
+    size_t running;
+    size_t unfinished;
+    size_t unjoined;
+    uint64_t instructionLimit;
+    // instructions executed by finished tasks
+    uint64_t executedInstructions;
+    // the error of the first task which failed
+    bool isFailed;
+    std::string error;
+
+    static WorkerPool& pool();
+
+    // the functions below are called with the mutex locked
+    void schedule(int id);
+    void wake(std::vector<int>& ids);
+    void fail(const std::string& error);
+    void notifyProgram();
+    TaskGroup::channel& findChannel(int index);
+    // runs the first ready task for a slice, the mutex is unlocked in the meantime
+    void runSlice(std::unique_lock<std::mutex>& lock);
+    // lets the program run a ready task or wait for a change, throws the error of a failed task or a deadlock
+    void waitForChange(std::unique_lock<std::mutex>& lock);
+public:
+    static const uint64_t sliceInstructions = 1 << 16;
+
+    TaskGroup(const Bytecode& bytecode, uint64_t instructionLimit);
+
+    // sets the register of the parent to the id of the new task
+    void spawn(BytecodeEngine& parent, int slot, size_t position);
+    // a spawned task gets false if it has to wait, it is resumed after a change; the program waits until they succeed
+    bool join(BytecodeEngine& task, int id);
+    bool send(BytecodeEngine& task, int index, int value);
+    bool receive(BytecodeEngine& task, int index, int& value);
+
+    // waits until all tasks have finished, called once the program has finished
+    void finish();
+    // stops all tasks once the program has failed, waits for slices which are running
+    void cancel();
+    uint64_t getExecutedInstructions();
+};
+
+// execution probe
+thread_local ExecutionProbe executionProbe;
+// enables publishing positions of running programs
+std::atomic<bool> isProbeEnabled{false};
+
+ProbeScope::ProbeScope()
+{
+    this->probe = isProbeEnabled.load(std::memory_order_relaxed) ? &executionProbe : nullptr;
+    if (this->probe) this->probe->depth.store(0, std::memory_order_relaxed);
 }
 
-// functions
-bool Interpreter::isConst(const std::string& str)
+ProbeScope::~ProbeScope()
 {
-    // This function checks if a string represents a valid integer
-    // Its behavior matches the regex: "^-?(0|[1-9]\\d*)$", which allows optional leading "-" and ensures no leading zeros unless the number is zero
+    if (this->probe) this->probe->position.store(0, std::memory_order_relaxed);
+}
 
-    if (str.empty()) return false;
-    if (str == "0" || str == "-0") return true;
-    if (str == "-") return false;
+ExecutionProbe* ProbeScope::get() const
+{
+    return this->probe;
+}
 
-    if (str.at(0) != '-' && (str.at(0) < '1' || str.at(0) > '9')) return false;
+// tracing
+//
+// While tracing is enabled, phases of runs (parse, link, execute, render message) and CALL/RET spans of the bytecode engine are recorded.
+// Every thread records events into its own ring buffer without any locking; when a buffer is full, the oldest events are overwritten.
+// Buffers of finished threads are reused by new threads, so memory grows only with the number of threads running at once.
+// Buffers are written as Chrome trace-event JSON (chrome://tracing, Perfetto) once tracing is finished.
 
-    for (size_t i = 1; i < str.length(); ++i) {
-        if (str.at(i) < '0' || str.at(i) > '9') return false;
+std::atomic<bool> isTracingEnabled{false};
+
+class TraceBuffer
+{
+private:
+    static const size_t capacity = 1 << 18;
+
+    struct event {
+        char phase;             // 'B' begin of a call, 'E' end of a call, 'X' complete phase
+        const char* name;       // name of a phase, nullptr for calls
+        uint32_t program;       // index into `programs` (calls)
+        uint32_t position;      // position of the called label (calls)
+        uint32_t depth;         // number of active calls (calls)
+        uint64_t instructions;  // executed instructions of the run at the time of the event (calls)
+        int64_t timestamp;      // nanoseconds
+        int64_t duration;       // nanoseconds (phases)
+    };
+
+    // all buffers, so they can be written after their threads finished
+    static std::mutex registryMutex;
+    static std::vector<std::unique_ptr<TraceBuffer>> registry;
+    // buffers of finished threads, taken by new threads, so there are never more buffers than threads running at once
+    static std::vector<TraceBuffer*> idle;
+    static std::chrono::steady_clock::time_point startTime;
+
+    size_t threadId;
+    std::vector<event> events;
+    // number of events ever recorded, written only by the owning thread
+    std::atomic<uint64_t> head;
+    // programs whose labels are named in events; kept alive until the trace is written
+    std::vector<std::shared_ptr<const Bytecode>> programs;
+
+    void record(const event& e);
+public:
+    explicit TraceBuffer(size_t threadId);
+
+    // returns the buffer of the current thread
+    static TraceBuffer* current();
+    static int64_t now();
+
+    // returns the index of the program in events, the same program used by consecutive runs is stored once
+    uint32_t addProgram(const std::shared_ptr<const Bytecode>& bytecode);
+    void beginCall(uint32_t program, size_t position, size_t depth, uint64_t instructions);
+    void endCall(size_t depth, uint64_t instructions);
+    void addPhase(const char* name, int64_t start);
+
+    // enables tracing and discards previously recorded events
+    static void start();
+    static void stop();
+    static void write(std::ostream& out);
+};
+
+std::mutex TraceBuffer::registryMutex;
+std::vector<std::unique_ptr<TraceBuffer>> TraceBuffer::registry;
+std::vector<TraceBuffer*> TraceBuffer::idle;
+std::chrono::steady_clock::time_point TraceBuffer::startTime = std::chrono::steady_clock::now();
+
+TraceBuffer::TraceBuffer(size_t threadId)
+    : threadId(threadId)
+{
+    this->events = std::vector<event>(TraceBuffer::capacity);
+    this->head = 0;
+    this->programs = {};
+}
+
+TraceBuffer* TraceBuffer::current()
+{
+    // a finished thread returns its buffer to `idle`, the events it recorded stay in the buffer until they are overwritten or written
+    // (the events of threads which used the same buffer are shown as one thread)
+    struct owner {
+        TraceBuffer* buffer = nullptr;
+
+        ~owner()
+        {
+            if (!this->buffer) return;
+            std::lock_guard<std::mutex> lock(TraceBuffer::registryMutex);
+            TraceBuffer::idle.push_back(this->buffer);
+        }
+    };
+    thread_local owner thread;
+    if (!thread.buffer) {
+        std::lock_guard<std::mutex> lock(TraceBuffer::registryMutex);
+        if (!TraceBuffer::idle.empty()) {
+            thread.buffer = TraceBuffer::idle.back();
+            TraceBuffer::idle.pop_back();
+        } else {
+            TraceBuffer::registry.push_back(std::unique_ptr<TraceBuffer>(new TraceBuffer(TraceBuffer::registry.size() + 1)));
+            thread.buffer = TraceBuffer::registry.back().get();
+        }
     }
+    return thread.buffer;
+}
 
-    return true;
+int64_t TraceBuffer::now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - TraceBuffer::startTime).count();
 }
 
-bool Interpreter::isRegister(const std::string& str)
+void TraceBuffer::record(const event& e)
 {
-    // This function checks if a string represents a valid register name
-    // A valid register name consists only of lowercase alphabetic characters ('a' to 'z')
-    // The behavior is equivalent to matching the regex pattern: "^[a-z]+$"
+    uint64_t h = this->head.load(std::memory_order_relaxed);
+    this->events[h % TraceBuffer::capacity] = e;
+    this->head.store(h + 1, std::memory_order_release);
+}
 
-    for (char c : str) {
-        if (c < 'a' || c > 'z') return false;
+uint32_t TraceBuffer::addProgram(const std::shared_ptr<const Bytecode>& bytecode)
+{
+    if (this->programs.empty() || this->programs.back() != bytecode) this->programs.push_back(bytecode);
+    return static_cast<uint32_t>(this->programs.size() - 1);
+}
+
+void TraceBuffer::beginCall(uint32_t program, size_t position, size_t depth, uint64_t instructions)
+{
+    this->record({'B', nullptr, program, static_cast<uint32_t>(position), static_cast<uint32_t>(depth), instructions, TraceBuffer::now(), 0});
+}
+
+void TraceBuffer::endCall(size_t depth, uint64_t instructions)
+{
+    this->record({'E', nullptr, 0, 0, static_cast<uint32_t>(depth), instructions, TraceBuffer::now(), 0});
+}
+
+void TraceBuffer::addPhase(const char* name, int64_t start)
+{
+    int64_t end = TraceBuffer::now();
+    this->record({'X', name, 0, 0, 0, 0, start, end - start});
+}
+
+void TraceBuffer::start()
+{
+    std::lock_guard<std::mutex> lock(TraceBuffer::registryMutex);
+    for (auto& buffer : TraceBuffer::registry) {
+        buffer->head = 0;
+        buffer->programs.clear();
     }
-    return true;
+    isTracingEnabled = true;
 }
 
-void Interpreter::parseProgram()
+void TraceBuffer::stop()
 {
-    // This function parses the program code stored in the `program` string.
-    // It processes each line, identifying instructions, their arguments, and subroutine labels.
-    // Comments starting with ';' are ignored, and leading/trailing whitespaces are trimmed.
-    // Entire program is stored in `this->instructions` as { type, args }.
-    // Subroutine positions are stored in `this->subroutines`.
-    //
-    // Key behaviors:
-    // - Lines with no instructions or only comments are skipped.
-    // - Subroutines (indicated by labels ending with ':') are stored as a position in the program.
-    // - Supported instructions are matched to their `InstructionType`. Unknown instructions are logged as errors and an exception is thrown.
-    // - Instruction arguments are parsed.
+    isTracingEnabled = false;
+}
 
-    std::stringstream l_program(this->program);
-    std::string line = "";
+void TraceBuffer::write(std::ostream& out)
+{
+    // This function must be called when no thread is recording events.
 
-    auto rtrim = [&](const std::string& str) -> std::string {
-        size_t pos = str.find_last_not_of(" \t\n\r\f\v");
-        return pos == std::string::npos ? "" : str.substr(0, pos + 1);
+    std::lock_guard<std::mutex> lock(TraceBuffer::registryMutex);
+
+    auto escape = [](const std::string& str) -> std::string {
+        std::string escaped = "";
+        for (char c : str) {
+            if (c == '"' || c == '\\') escaped += '\\';
+            if (static_cast<unsigned char>(c) >= 0x20) escaped += c;
+        }
+        return escaped;
     };
-    auto ltrim = [&](const std::string& str) -> std::string {
-        size_t pos = str.find_first_not_of(" \t\n\r\f\v");
-        return pos == std::string::npos ? "" : str.substr(pos);
+
+    out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    bool isFirst = true;
+    for (auto& buffer : TraceBuffer::registry) {
+        uint64_t h = buffer->head.load(std::memory_order_acquire);
+        uint64_t first = h > TraceBuffer::capacity ? h - TraceBuffer::capacity : 0;
+
+        // names of labels by program and position
+        std::vector<std::unordered_map<size_t, std::string>> names{};
+        for (const auto& program : buffer->programs) {
+            names.push_back({});
+            for (const auto& label : program->labels) {
+                auto it = names.back().find(label.second);
+                if (it == names.back().end() || label.first < it->second) names.back()[label.second] = label.first;
+            }
+        }
+
+        // begin events of open calls, end events whose begin was overwritten are skipped
+        std::vector<std::pair<std::string, uint64_t>> openCalls{};
+        for (uint64_t i = first; i < h; ++i) {
+            const event& e = buffer->events[i % TraceBuffer::capacity];
+            std::string name = "";
+            std::string args = "";
+
+            if (e.phase == 'X') {
+                name = e.name;
+            } else if (e.phase == 'B') {
+                auto it = names[e.program].find(e.position);
+                name = it == names[e.program].end() ? "@" + std::to_string(e.position) : it->second;
+                openCalls.push_back({name, e.instructions});
+                args = ",\"args\":{\"depth\":" + std::to_string(e.depth) + "}";
+            } else {
+                if (openCalls.empty()) continue;
+                name = openCalls.back().first;
+                args = ",\"args\":{\"depth\":" + std::to_string(e.depth) + ",\"instructions\":" + std::to_string(e.instructions - openCalls.back().second) + "}";
+                openCalls.pop_back();
+            }
+
+            out << (isFirst ? "" : ",") << "\n{\"name\":\"" << escape(name) << "\",\"cat\":\"" << (e.phase == 'X' ? "run" : "call")
+                << "\",\"ph\":\"" << e.phase << "\",\"pid\":1,\"tid\":" << buffer->threadId
+                << ",\"ts\":" << static_cast<double>(e.timestamp) / 1000.0;
+            if (e.phase == 'X') out << ",\"dur\":" << static_cast<double>(e.duration) / 1000.0;
+            out << args << "}";
+            isFirst = false;
+        }
+    }
+    out << "\n]}\n";
+}
+
+// records a phase from its construction until its destruction, if tracing is enabled
+class TraceSpan
+{
+private:
+    const char* name;
+    TraceBuffer* buffer;
+    int64_t start;
+public:
+    explicit TraceSpan(const char* name);
+    ~TraceSpan();
+};
+
+TraceSpan::TraceSpan(const char* name)
+    : name(name)
+{
+    this->buffer = isTracingEnabled.load(std::memory_order_relaxed) ? TraceBuffer::current() : nullptr;
+    this->start = this->buffer ? TraceBuffer::now() : 0;
+}
+
+TraceSpan::~TraceSpan()
+{
+    if (this->buffer) this->buffer->addPhase(this->name, this->start);
+}
+
+// metrics
+//
+// While metrics are enabled, latencies of run phases, executed instructions and faults are recorded into process-wide metrics,
+// which can be written in the Prometheus text format. Recording is lock-free except for faults, which are rare.
+
+std::atomic<bool> isMetricsEnabled{false};
+
+// a histogram with buckets of logarithmically growing width (HDR-style)
+// every power of two is split into 16 buckets, so recorded values keep about 6% precision over the whole range of uint64_t
+class Histogram
+{
+private:
+    static const uint64_t subBuckets = 16;
+    static const size_t bucketCount = 64 * subBuckets;
+
+    std::atomic<uint64_t> buckets[bucketCount];
+    std::atomic<uint64_t> count;
+    std::atomic<uint64_t> sum;
+    std::atomic<uint64_t> max;
+
+    static size_t bucketOf(uint64_t value);
+    // the greatest value stored in the bucket
+    static uint64_t upperBound(size_t bucket);
+public:
+    Histogram();
+
+    void record(uint64_t value);
+    uint64_t getCount() const;
+    // returns the value which is greater than or equal to the given fraction of recorded values
+    uint64_t percentile(double fraction) const;
+
+    // writes the histogram as a Prometheus summary, values are multiplied by `scale` (e.g. 1e-9 for nanoseconds in seconds)
+    void write(std::ostream& out, const std::string& name, const std::string& help, double scale) const;
+};
+
+Histogram::Histogram()
+{
+    for (std::atomic<uint64_t>& bucket : this->buckets) bucket = 0;
+    this->count = 0;
+    this->sum = 0;
+    this->max = 0;
+}
+
+size_t Histogram::bucketOf(uint64_t value)
+{
+    if (value < Histogram::subBuckets) return static_cast<size_t>(value);
+    int exponent = 63;
+    while (!(value >> exponent)) exponent--;
+    uint64_t sub = (value >> (exponent - 4)) & (Histogram::subBuckets - 1);
+    return static_cast<size_t>((exponent - 3) * Histogram::subBuckets + sub);
+}
+
+uint64_t Histogram::upperBound(size_t bucket)
+{
+    if (bucket < Histogram::subBuckets) return bucket;
+    int exponent = static_cast<int>(bucket / Histogram::subBuckets) + 3;
+    uint64_t lower = (Histogram::subBuckets + bucket % Histogram::subBuckets) << (exponent - 4);
+    return lower + ((1ULL << (exponent - 4)) - 1);
+}
+
+void Histogram::record(uint64_t value)
+{
+    this->buckets[Histogram::bucketOf(value)].fetch_add(1, std::memory_order_relaxed);
+    this->count.fetch_add(1, std::memory_order_relaxed);
+    this->sum.fetch_add(value, std::memory_order_relaxed);
+    uint64_t previous = this->max.load(std::memory_order_relaxed);
+    while (value > previous && !this->max.compare_exchange_weak(previous, value, std::memory_order_relaxed)) {}
+}
+
+uint64_t Histogram::getCount() const
+{
+    return this->count.load(std::memory_order_relaxed);
+}
+
+uint64_t Histogram::percentile(double fraction) const
+{
+    uint64_t total = 0;
+    for (const std::atomic<uint64_t>& bucket : this->buckets) total += bucket.load(std::memory_order_relaxed);
+    if (total == 0) return 0;
+
+    uint64_t rank = static_cast<uint64_t>(fraction * static_cast<double>(total) + 0.5);
+    uint64_t seen = 0;
+    for (size_t i = 0; i < Histogram::bucketCount; ++i) {
+        seen += this->buckets[i].load(std::memory_order_relaxed);
+        if (seen >= std::max<uint64_t>(rank, 1)) return std::min(Histogram::upperBound(i), this->max.load(std::memory_order_relaxed));
+    }
+    return this->max.load(std::memory_order_relaxed);
+}
+
+void Histogram::write(std::ostream& out, const std::string& name, const std::string& help, double scale) const
+{
+    out << "# HELP " << name << ' ' << help << '\n';
+    out << "# TYPE " << name << " summary\n";
+    for (double q : {0.5, 0.9, 0.99, 0.999}) {
+        out << name << "{quantile=\"" << q << "\"} " << static_cast<double>(this->percentile(q)) * scale << '\n';
+    }
+    out << name << "{quantile=\"1\"} " << static_cast<double>(this->max.load()) * scale << '\n';
+    out << name << "_sum " << static_cast<double>(this->sum.load()) * scale << '\n';
+    out << name << "_count " << this->count.load() << '\n';
+}
+
+struct Metrics {
+    // nanoseconds
+    Histogram parseLatency;
+    Histogram linkLatency;
+    Histogram executeLatency;
+    // time from receiving a request by the daemon until its response is ready, nanoseconds
+    Histogram requestLatency;
+    Histogram instructionsPerRun;
+
+    std::atomic<uint64_t> cacheHits{0};
+    std::atomic<uint64_t> cacheMisses{0};
+    // tasks waiting in worker pools
+    std::atomic<int64_t> queueDepth{0};
+
+    std::mutex faultMutex;
+    // number of faults by their type, which is the error without details (e.g. "ERROR::INTERPRETER::DIVISION_BY_ZERO")
+    std::map<std::string, uint64_t> faults;
+
+    void recordFault(const std::string& error);
+    // writes all metrics in the Prometheus text format
+    void write(std::ostream& out);
+};
+
+Metrics metrics{};
+
+void Metrics::recordFault(const std::string& error)
+{
+    std::lock_guard<std::mutex> lock(this->faultMutex);
+    this->faults[error.substr(0, error.find(':', error.rfind("::") + 2))]++;
+}
+
+void Metrics::write(std::ostream& out)
+{
+    this->parseLatency.write(out, "assembler_parse_seconds", "Time of parsing programs.", 1e-9);
+    this->linkLatency.write(out, "assembler_link_seconds", "Time of linking programs into bytecode.", 1e-9);
+    this->executeLatency.write(out, "assembler_execute_seconds", "Time of running programs.", 1e-9);
+    this->requestLatency.write(out, "assembler_request_seconds", "Time from receiving a request by the daemon until its response is ready.", 1e-9);
+    this->instructionsPerRun.write(out, "assembler_instructions_per_run", "Number of instructions executed by a run.", 1);
+
+    uint64_t hits = this->cacheHits.load();
+    uint64_t misses = this->cacheMisses.load();
+    out << "# HELP assembler_program_cache_hits_total Programs found in the program cache.\n"
+        << "# TYPE assembler_program_cache_hits_total counter\n"
+        << "assembler_program_cache_hits_total " << hits << '\n'
+        << "# HELP assembler_program_cache_misses_total Programs compiled because they were not in the program cache.\n"
+        << "# TYPE assembler_program_cache_misses_total counter\n"
+        << "assembler_program_cache_misses_total " << misses << '\n'
+        << "# HELP assembler_program_cache_hit_ratio Fraction of programs found in the program cache.\n"
+        << "# TYPE assembler_program_cache_hit_ratio gauge\n"
+        << "assembler_program_cache_hit_ratio " << (hits + misses > 0 ? static_cast<double>(hits) / static_cast<double>(hits + misses) : 0.0) << '\n'
+        << "# HELP assembler_queue_depth Tasks waiting for a worker thread.\n"
+        << "# TYPE assembler_queue_depth gauge\n"
+        << "assembler_queue_depth " << this->queueDepth.load() << '\n';
+
+    out << "# HELP assembler_faults_total Runs which failed, by error type.\n"
+        << "# TYPE assembler_faults_total counter\n";
+    std::lock_guard<std::mutex> lock(this->faultMutex);
+    for (const auto& fault : this->faults) out << "assembler_faults_total{type=\"" << fault.first << "\"} " << fault.second << '\n';
+}
+
+// records the time from its construction until its destruction into a histogram, if metrics are enabled
+class LatencyTimer
+{
+private:
+    Histogram* histogram;
+    std::chrono::steady_clock::time_point start;
+public:
+    explicit LatencyTimer(Histogram& histogram);
+    ~LatencyTimer();
+};
+
+LatencyTimer::LatencyTimer(Histogram& histogram)
+{
+    this->histogram = isMetricsEnabled.load(std::memory_order_relaxed) ? &histogram : nullptr;
+    if (this->histogram) this->start = std::chrono::steady_clock::now();
+}
+
+LatencyTimer::~LatencyTimer()
+{
+    if (this->histogram) {
+        auto duration = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - this->start);
+        this->histogram->record(static_cast<uint64_t>(duration.count()));
+    }
+}
+
+// control flow recording
+void writeVarint(std::string& out, uint64_t value)
+{
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+uint64_t readVarint(const std::string& data, size_t& position)
+{
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (position >= data.size()) throw std::string("ERROR::TRACE::INVALID_FORMAT: unexpected end of file");
+        uint8_t byte = static_cast<uint8_t>(data[position++]);
+        value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if (byte < 0x80) return value;
+    }
+    throw std::string("ERROR::TRACE::INVALID_FORMAT: invalid varint");
+}
+
+// maps signed values to unsigned ones so that numbers close to 0 get short varints: 0, -1, 1, -2, ... -> 0, 1, 2, 3, ...
+uint64_t zigzag(int64_t value)
+{
+    return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+int64_t unzigzag(uint64_t value)
+{
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+// records the control flow of compiled programs, so runs can be replayed and checked later (see TraceReader)
+// only the decisions which can not be derived from the bytecode are recorded: whether conditional jumps were taken and where RET and JTAB continued
+//
+// the running program only appends raw events to a buffer, full buffers are encoded and written to the file by a background thread
+// file format: "ASMTRACE1\n", varint length + serialized bytecode, then packets:
+//   0x02..0x7f  up to 6 conditional jumps, one bit each (1 = taken, oldest first) behind a leading 1 bit
+//   0x80        RET or JTAB, zigzag varint of the difference to the previous such position of the run
+//   0x81        start of a run: varint count, then count * (varint slot, zigzag varint value) of the initial registers
+//   0x82        end of a run: varint 1 if it failed, varint executed instructions, varint count + zigzag varint register values,
+//               varint length + output or error
+class TraceRecorder
+{
+private:
+    static const size_t chunkSize = 1 << 16;
+    static const size_t maxPendingChunks = 16;
+
+    // raw events of the current chunk
+    std::vector<uint32_t> events;
+
+    // false if the events are only kept in memory
+    bool isWriting;
+    std::ofstream file;
+    std::thread writer;
+    std::mutex mutex;
+    std::condition_variable condition;
+    // full chunks waiting for the writer and empty chunks which can be reused
+    std::deque<std::vector<uint32_t>> chunks;
+    std::vector<std::vector<uint32_t>> freeChunks;
+    bool isClosing;
+
+    // state of the encoder, used only by the writer
+    uint32_t pendingBranches;
+    int64_t lastTarget;
+
+    void flush();
+    void runWriter();
+    void encode(const std::vector<uint32_t>& chunk, std::string& out);
+    void encodeBranches(std::string& out);
+public:
+    // raw events: 0 or 1 for a conditional jump which was not taken or taken, `targetEvent | position` for RET and JTAB,
+    // `runStartEvent | count` and `runEndEvent | failed` followed by the data of the run
+    static const uint32_t targetEvent = 0x80000000u;
+    static const uint32_t runStartEvent = 0xC0000000u;
+    static const uint32_t runEndEvent = 0xE0000000u;
+
+    // keeps the events in memory (see getEvents())
+    TraceRecorder();
+    // writes the events into a file, starting with the bytecode of the recorded program
+    TraceRecorder(const std::string& path, const Bytecode& bytecode);
+    ~TraceRecorder();
+
+    void branch(bool isTaken);
+    // the position where RET or JTAB continued
+    void target(size_t position);
+
+    // `inputs` are pairs of register slot and initial value
+    void beginRun(const std::vector<std::pair<int, int>>& inputs);
+    void endRun(bool isFailed, uint64_t instructions, const std::vector<int>& registers, const std::string& output);
+
+    // writes the remaining events and waits for the writer
+    void close();
+
+    const std::vector<uint32_t>& getEvents() const;
+    void clear();
+};
+
+TraceRecorder::TraceRecorder()
+{
+    this->events = {};
+    this->isWriting = false;
+    this->isClosing = false;
+    this->pendingBranches = 1;
+    this->lastTarget = 0;
+}
+
+TraceRecorder::TraceRecorder(const std::string& path, const Bytecode& bytecode)
+    : TraceRecorder()
+{
+    this->file.open(path, std::ios::binary);
+    if (!this->file) throw "ERROR::FILE::CAN_NOT_OPEN: " + path;
+
+    std::string header = "ASMTRACE1\n";
+    std::string serialized = bytecode.serialize();
+    writeVarint(header, serialized.size());
+    header += serialized;
+    this->file.write(header.data(), static_cast<std::streamsize>(header.size()));
+
+    this->isWriting = true;
+    this->events.reserve(TraceRecorder::chunkSize);
+    this->writer = std::thread(&TraceRecorder::runWriter, this);
+}
+
+TraceRecorder::~TraceRecorder()
+{
+    try {
+        this->close();
+    } catch (const std::string&) {
+    }
+}
+
+void TraceRecorder::branch(bool isTaken)
+{
+    this->events.push_back(isTaken ? 1u : 0u);
+    if (this->isWriting && this->events.size() >= TraceRecorder::chunkSize) this->flush();
+}
+
+void TraceRecorder::target(size_t position)
+{
+    this->events.push_back(TraceRecorder::targetEvent | static_cast<uint32_t>(position));
+    if (this->isWriting && this->events.size() >= TraceRecorder::chunkSize) this->flush();
+}
+
+void TraceRecorder::beginRun(const std::vector<std::pair<int, int>>& inputs)
+{
+    this->events.push_back(TraceRecorder::runStartEvent | static_cast<uint32_t>(inputs.size()));
+    for (const auto& input : inputs) {
+        this->events.push_back(static_cast<uint32_t>(input.first));
+        this->events.push_back(static_cast<uint32_t>(input.second));
+    }
+}
+
+void TraceRecorder::endRun(bool isFailed, uint64_t instructions, const std::vector<int>& registers, const std::string& output)
+{
+    this->events.push_back(TraceRecorder::runEndEvent | (isFailed ? 1u : 0u));
+    this->events.push_back(static_cast<uint32_t>(instructions));
+    this->events.push_back(static_cast<uint32_t>(instructions >> 32));
+    this->events.push_back(static_cast<uint32_t>(registers.size()));
+    for (int value : registers) this->events.push_back(static_cast<uint32_t>(value));
+    // the text is packed into 4 bytes per event
+    this->events.push_back(static_cast<uint32_t>(output.size()));
+    for (size_t i = 0; i < output.size(); i += 4) {
+        uint32_t word = 0;
+        for (size_t j = 0; j < 4 && i + j < output.size(); ++j) word |= static_cast<uint32_t>(static_cast<uint8_t>(output[i + j])) << (8 * j);
+        this->events.push_back(word);
+    }
+    if (this->isWriting && this->events.size() >= TraceRecorder::chunkSize) this->flush();
+}
+
+void TraceRecorder::flush()
+{
+    // This function hands the current chunk to the writer, the program waits only if the writer falls far behind.
+
+    std::vector<uint32_t> next{};
+    {
+        std::unique_lock<std::mutex> lock(this->mutex);
+        this->condition.wait(lock, [this]() { return this->chunks.size() < TraceRecorder::maxPendingChunks; });
+        this->chunks.push_back(std::move(this->events));
+        if (!this->freeChunks.empty()) {
+            next = std::move(this->freeChunks.back());
+            this->freeChunks.pop_back();
+        }
+    }
+    this->condition.notify_all();
+
+    this->events = std::move(next);
+    this->events.reserve(TraceRecorder::chunkSize);
+}
+
+void TraceRecorder::runWriter()
+{
+    std::string out = "";
+    while (true) {
+        std::vector<uint32_t> chunk{};
+        {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            this->condition.wait(lock, [this]() { return !this->chunks.empty() || this->isClosing; });
+            if (this->chunks.empty()) break;
+            chunk = std::move(this->chunks.front());
+            this->chunks.pop_front();
+        }
+        this->condition.notify_all();
+
+        out.clear();
+        this->encode(chunk, out);
+        this->file.write(out.data(), static_cast<std::streamsize>(out.size()));
+
+        chunk.clear();
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->freeChunks.push_back(std::move(chunk));
+    }
+
+    out.clear();
+    this->encodeBranches(out);
+    this->file.write(out.data(), static_cast<std::streamsize>(out.size()));
+    this->file.flush();
+}
+
+void TraceRecorder::encodeBranches(std::string& out)
+{
+    if (this->pendingBranches > 1) out.push_back(static_cast<char>(this->pendingBranches));
+    this->pendingBranches = 1;
+}
+
+void TraceRecorder::encode(const std::vector<uint32_t>& chunk, std::string& out)
+{
+    // a run may span several chunks, since branch() and target() flush in the middle of it; the records of beginRun() and endRun()
+    // are never split, because a chunk is only flushed after a complete event. Pending branches and the last target are carried
+    // over to the next chunk, chunks are encoded in order by the writer thread.
+    for (size_t i = 0; i < chunk.size(); ++i) {
+        uint32_t event = chunk[i];
+        if (event <= 1) {
+            this->pendingBranches = (this->pendingBranches << 1) | event;
+            // 6 bits behind the leading 1 bit
+            if (this->pendingBranches >= 0x40) this->encodeBranches(out);
+            continue;
+        }
+
+        this->encodeBranches(out);
+        if ((event & TraceRecorder::runStartEvent) == TraceRecorder::targetEvent) {
+            int64_t position = event & ~TraceRecorder::targetEvent;
+            out.push_back(static_cast<char>(0x80));
+            writeVarint(out, zigzag(position - this->lastTarget));
+            this->lastTarget = position;
+        } else if ((event & TraceRecorder::runEndEvent) == TraceRecorder::runStartEvent) {
+            uint32_t count = event & ~TraceRecorder::runEndEvent;
+            out.push_back(static_cast<char>(0x81));
+            writeVarint(out, count);
+            for (uint32_t j = 0; j < count; ++j) {
+                writeVarint(out, chunk[++i]);
+                writeVarint(out, zigzag(static_cast<int32_t>(chunk[++i])));
+            }
+            this->lastTarget = 0;
+        } else {
+            out.push_back(static_cast<char>(0x82));
+            writeVarint(out, event & 1);
+            uint64_t instructions = chunk[i + 1] | (static_cast<uint64_t>(chunk[i + 2]) << 32);
+            writeVarint(out, instructions);
+            i += 2;
+            uint32_t count = chunk[++i];
+            writeVarint(out, count);
+            for (uint32_t j = 0; j < count; ++j) writeVarint(out, zigzag(static_cast<int32_t>(chunk[++i])));
+            uint32_t length = chunk[++i];
+            writeVarint(out, length);
+            for (uint32_t j = 0; j < length; j += 4) {
+                uint32_t word = chunk[++i];
+                for (uint32_t k = 0; k < 4 && j + k < length; ++k) out.push_back(static_cast<char>((word >> (8 * k)) & 0xff));
+            }
+        }
+    }
+}
+
+void TraceRecorder::close()
+{
+    if (!this->isWriting) return;
+    this->isWriting = false;
+
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        if (!this->events.empty()) this->chunks.push_back(std::move(this->events));
+        this->isClosing = true;
+    }
+    this->condition.notify_all();
+    this->writer.join();
+
+    this->events = {};
+    if (!this->file) throw std::string("ERROR::FILE::CAN_NOT_WRITE: trace");
+    this->file.close();
+}
+
+const std::vector<uint32_t>& TraceRecorder::getEvents() const
+{
+    return this->events;
+}
+
+void TraceRecorder::clear()
+{
+    this->events.clear();
+}
+
+// init functions
+void Interpreter::initVariables()
+{
+    this->regs = {};
+    this->cmpResult = 0;
+    this->subroutines = {};
+    this->instructions = {};
+    this->macros = {};
+    this->macroInvocations = 0;
+    this->messagePattern = {};
+    this->output = "-1";
+    this->instructionLimit = UINT64_MAX;
+    this->memory = {};
+    this->dataStack = {};
+    this->vectors = std::vector<int>(Bytecode::vectorRegisters * Bytecode::vectorLanes, 0);
+    this->channelCapacities = {};
+    this->channels = {};
+    this->tasks = {};
+}
+
+// functions
+bool Interpreter::isConst(const std::string& str) const
+{
+    // This function checks if a string represents a valid integer
+    // Its behavior matches the regex: "^-?(0|[1-9]\\d*)$", which allows optional leading "-" and ensures no leading zeros unless the number is zero
+
+    if (str.empty()) return false;
+    if (str == "0" || str == "-0") return true;
+    if (str == "-") return false;
+
+    if (str.at(0) != '-' && (str.at(0) < '1' || str.at(0) > '9')) return false;
+
+    for (size_t i = 1; i < str.length(); ++i) {
+        if (str.at(i) < '0' || str.at(i) > '9') return false;
+    }
+
+    return true;
+}
+
+bool Interpreter::isRegister(const std::string& str) const
+{
+    // This function checks if a string represents a valid register name
+    // A valid register name consists only of lowercase alphabetic characters ('a' to 'z')
+    // The behavior is equivalent to matching the regex pattern: "^[a-z]+$"
+
+    for (char c : str) {
+        if (c < 'a' || c > 'z') return false;
+    }
+    return true;
+}
+
+int Interpreter::findVectorRegister(const std::string& str) const
+{
+    // This function checks if a string is a vector register name: 'v' followed by a number from 0 to 15 without leading zeros
+
+    if (str.length() < 2 || str.length() > 3 || str.at(0) != 'v') return -1;
+    std::string number = str.substr(1);
+    if (!this->isConst(number) || number.at(0) == '-') return -1;
+    int index = std::stoi(number);
+    return index < Bytecode::vectorRegisters ? index : -1;
+}
+
+void Interpreter::parseProgram()
+{
+    // This function parses the program code stored in the `program` string.
+    // It processes each line, identifying instructions, their arguments, and subroutine labels.
+    // Comments starting with ';' are ignored, and leading/trailing whitespaces are trimmed.
+    // Entire program is stored in `this->instructions` as { type, args }.
+    // Subroutine positions are stored in `this->subroutines`.
+    //
+    // Key behaviors:
+    // - Lines with no instructions or only comments are skipped.
+    // - Subroutines (indicated by labels ending with ':') are stored as a position in the program.
+    // - Supported instructions are matched to their `InstructionType`. Unknown instructions are logged as errors and an exception is thrown.
+    // - Instruction arguments are parsed.
+    // - Lines between "%macro name param, ..." and "%endm" define a macro. A line invoking it ("name arg, ...") is replaced
+    //   with its body, in which every parameter is replaced with its argument. Arguments are separated by commas like those of MSG,
+    //   so quoted text passes intact. Bodies are expanded once per definition and arguments and reused by later invocations;
+    //   they may invoke other macros, but not define them.
+
+    TraceSpan span("parse");
+    LatencyTimer timer(metrics.parseLatency);
+
+    std::stringstream l_program(this->program);
+    std::string line = "";
+
+    auto rtrim = [&](const std::string& str) -> std::string {
+        size_t pos = str.find_last_not_of(" \t\n\r\f\v");
+        return pos == std::string::npos ? "" : str.substr(0, pos + 1);
+    };
+    auto ltrim = [&](const std::string& str) -> std::string {
+        size_t pos = str.find_first_not_of(" \t\n\r\f\v");
+        return pos == std::string::npos ? "" : str.substr(pos);
+    };
+    auto trim = [&](const std::string& str) -> std::string { return rtrim(ltrim(str)); };
+
+    // a map which allows to convert string into enum (InstructionType)
+    static const std::unordered_map<std::string, InstructionType> instructionTypeMap{
+        { "mov", InstructionType::MOV },
+        { "inc", InstructionType::INC },
+        { "dec", InstructionType::DEC },
+        { "add", InstructionType::ADD },
+        { "sub", InstructionType::SUB },
+        { "mul", InstructionType::MUL },
+        { "div", InstructionType::DIV },
+        { "jmp", InstructionType::JMP },
+        { "cmp", InstructionType::CMP },
+        { "jne", InstructionType::JNE },
+        { "je", InstructionType::JE },
+        { "jge", InstructionType::JGE },
+        { "jg", InstructionType::JG },
+        { "jle", InstructionType::JLE },
+        { "jl", InstructionType::JL },
+        { "call", InstructionType::CALL },
+        { "msg", InstructionType::MSG },
+        { "ret", InstructionType::RET },
+        { "end", InstructionType::END },
+        { "and", InstructionType::AND },
+        { "or", InstructionType::OR },
+        { "xor", InstructionType::XOR },
+        { "not", InstructionType::NOT },
+        { "shl", InstructionType::SHL },
+        { "shr", InstructionType::SHR },
+        { "mod", InstructionType::MOD },
+        { "loop", InstructionType::LOOP },
+        { "jnz", InstructionType::JNZ },
+        { "jz", InstructionType::JZ },
+        { "cmovne", InstructionType::CMOVNE },
+        { "cmove", InstructionType::CMOVE },
+        { "cmovge", InstructionType::CMOVGE },
+        { "cmovg", InstructionType::CMOVG },
+        { "cmovle", InstructionType::CMOVLE },
+        { "cmovl", InstructionType::CMOVL },
+        { "jtab", InstructionType::JTAB },
+        { "load", InstructionType::LOAD },
+        { "store", InstructionType::STORE },
+        { "memset", InstructionType::MEMSET },
+        { "memcpy", InstructionType::MEMCPY },
+        { "push", InstructionType::PUSH },
+        { "pop", InstructionType::POP },
+        { "vmov", InstructionType::VMOV },
+        { "vadd", InstructionType::VADD },
+        { "vsub", InstructionType::VSUB },
+        { "vmul", InstructionType::VMUL },
+        { "vmin", InstructionType::VMIN },
+        { "vmax", InstructionType::VMAX },
+        { "vcmpeq", InstructionType::VCMPEQ },
+        { "vcmpgt", InstructionType::VCMPGT },
+        { "vset", InstructionType::VSET },
+        { "vhsum", InstructionType::VHSUM },
+        { "vhmin", InstructionType::VHMIN },
+        { "vhmax", InstructionType::VHMAX },
+        { "vload", InstructionType::VLOAD },
+        { "vstore", InstructionType::VSTORE },
+        { "syscall", InstructionType::SYSCALL },
+        { "spawn", InstructionType::SPAWN },
+        { "join", InstructionType::JOIN },
+        { "send", InstructionType::SEND },
+        { "recv", InstructionType::RECV }
+    };
+
+    // splits the arguments of MSG and of macro invocations at commas, quoted text may contain commas and spaces
+    auto splitQuoted = [](const std::string& text) -> std::vector<std::string> {
+        std::vector<std::string> args{};
+        std::string arg = "";
+        bool insideQuote = false;
+        for (char c : text) {
+            // ingore leading whitespaces the first character is found
+            if (c == ' ' && arg.length() == 0) continue;
+            // track if an arg is a text between apostrophes
+            if (c == '\'') insideQuote = !insideQuote;
+            // a comma indicates the end of the current argument, but only if it is outside quoted text
+            else if (c == ',' && !insideQuote) {
+                args.push_back(arg);
+                arg = "";
+                continue;
+            }
+            arg += c;
+        }
+        // add the final arg to the list
+        if (arg.length() > 0) args.push_back(arg);
+        return args;
+    };
+    // replaces parameters in the arguments of a line of a macro body, the mnemonic and quoted text stay unchanged
+    auto substitute = [&](const std::string& text, const Interpreter::macro& m, const std::vector<std::string>& args) -> std::string {
+        size_t pos = text.find_first_of(" \t");
+        if (pos == std::string::npos) return text;
+        std::string result = text.substr(0, pos);
+        bool insideQuote = false;
+        while (pos < text.length()) {
+            char c = text.at(pos);
+            if (c == '\'') insideQuote = !insideQuote;
+            if (insideQuote || c == '\'' || c == ',' || c == ' ' || c == '\t') {
+                result += c;
+                ++pos;
+                continue;
+            }
+            size_t end = text.find_first_of(" \t,'", pos);
+            if (end == std::string::npos) end = text.length();
+            std::string word = text.substr(pos, end - pos);
+            auto param = std::find(m.params.begin(), m.params.end(), word);
+            result += param == m.params.end() ? word : args[param - m.params.begin()];
+            pos = end;
+        }
+        return result;
+    };
+    // gives local labels of an invocation their own names, "%%name" becomes "%<invocation>.name"
+    auto localize = [&](const std::string& text, const std::string& prefix) -> std::string {
+        std::string result = "";
+        size_t pos = 0;
+        for (size_t found = text.find("%%"); found != std::string::npos; found = text.find("%%", pos)) {
+            result += text.substr(pos, found - pos) + prefix;
+            pos = found + 2;
+        }
+        return result + text.substr(pos);
+    };
+
+    // lines of invoked macro bodies which are still to be parsed, in reverse order, with the depth of macro invocations
+    std::vector<std::pair<std::string, int>> pending{};
+    size_t expandedLines = 0;
+    // the macro whose body is being defined, nullptr outside of a definition
+    Interpreter::macro* defining = nullptr;
+    std::string definingName = "";
+
+    while (!pending.empty() || std::getline(l_program, line)) {
+        int depth = 0;
+        if (!pending.empty()) {
+            line = std::move(pending.back().first);
+            depth = pending.back().second;
+            pending.pop_back();
+        }
+
+        // remove everything after first ';' (crop comments)
+        line = [&](std::string& str) -> std::string {
+            size_t pos = str.find(';');
+            return pos == std::string::npos ? str : str.substr(0, pos);
+        }(line);
+        // remove whitespaces at the beginning and at the end of the string
+        line = trim(line);
+
+        // ignore empty lines
+        if (line.length() == 0) continue;
+        
+        std::stringstream ss(line);
+        std::string type = "";
+        ss >> type;
+
+        InstructionType instructionType = InstructionType::NONE;
+
+        // lines of a macro definition are stored until "%endm" instead of being parsed
+        if (defining != nullptr) {
+            if (type == "%macro" || (type == "%endm" && line != type)) throw "ERROR::INTERPRETER::INVALID_MACRO: " + line;
+            if (type == "%endm") {
+                defining = nullptr;
+            } else {
+                defining->hasLocals = defining->hasLocals || line.find("%%") != std::string::npos;
+                defining->body.push_back(line);
+            }
+            continue;
+        }
+
+        // check if the current line starts a macro definition
+        if (type == "%macro") {
+            std::vector<std::string> params{};
+            std::string name = "";
+            std::string param = "";
+            ss >> name;
+            while (ss >> param) params.push_back(param.back() == ',' ? param.substr(0, param.length() - 1) : param);
+            // names are register names which are not mnemonics, so a macro never hides an instruction
+            bool isValid = !name.empty() && this->isRegister(name) && instructionTypeMap.count(name) == 0 && this->macros.count(name) == 0;
+            for (size_t i = 0; i < params.size(); ++i) {
+                isValid = isValid && !params[i].empty() && this->isRegister(params[i]);
+                isValid = isValid && std::find(params.begin(), params.begin() + i, params[i]) == params.begin() + i;
+            }
+            if (!isValid) throw "ERROR::INTERPRETER::INVALID_MACRO: " + line;
+            defining = &this->macros[name];
+            defining->params = params;
+            defining->hasLocals = false;
+            definingName = name;
+            continue;
+        }
+        if (type == "%endm") throw "ERROR::INTERPRETER::INVALID_MACRO: " + line;
+
+        // check if the current line invokes a macro, its body is parsed next
+        auto invoked = this->macros.find(type);
+        if (invoked != this->macros.end()) {
+            Interpreter::macro& m = invoked->second;
+            std::vector<std::string> args{};
+            std::string rest = "";
+            std::getline(ss, rest);
+            for (const std::string& arg : splitQuoted(rest)) args.push_back(trim(arg));
+            if (args.size() != m.params.size()) throw "ERROR::INTERPRETER::INVALID_MACRO_ARGS: " + line;
+            if (depth >= Interpreter::maxMacroDepth) throw "ERROR::INTERPRETER::MACRO_TOO_DEEP: " + type;
+
+            std::string key = "";
+            // arguments may contain spaces, but never a line break
+            for (const std::string& a : args) key += a + "\n";
+            auto expansion = m.expansions.find(key);
+            if (expansion == m.expansions.end()) {
+                std::vector<std::string> body{};
+                body.reserve(m.body.size());
+                for (const std::string& l : m.body) body.push_back(substitute(l, m, args));
+                expansion = m.expansions.emplace(key, std::move(body)).first;
+            }
+
+            expandedLines += expansion->second.size();
+            if (expandedLines > Interpreter::maxExpandedLines) throw "ERROR::INTERPRETER::MACRO_TOO_LARGE: " + type;
+            std::string prefix = "%" + std::to_string(this->macroInvocations++) + ".";
+            for (auto it = expansion->second.rbegin(); it != expansion->second.rend(); ++it) {
+                pending.emplace_back(m.hasLocals ? localize(*it, prefix) : *it, depth + 1);
+            }
+            continue;
+        }
+
+        // check if the current instruction is a label
+        if (type.length() > 1 && type.back() == ':') {
+            std::string subroutine = type.substr(0, type.length() - 1);
+            // set the position of the subroutine
+            this->subroutines[subroutine] = this->instructions.size();
+            continue;
+        }
+
+        // check if the current line is a directive
+        if (type.at(0) == '.') {
+            std::vector<std::string> args{};
+            std::string arg = "";
+            while (ss >> arg) args.push_back(arg.back() == ',' ? arg.substr(0, arg.length() - 1) : arg);
+            this->parseDirective(type, args);
+            continue;
+        }
+
+        // assigns the corresponding InstructionType based on the input string 'type'
+        auto it = instructionTypeMap.find(type);
+        if (it != instructionTypeMap.end()) {
+            instructionType = it->second;
+        } else {
+            throw "ERROR::INTERPRETER::UNKOWN_INSTRUCTION_TYPE: " + type;
+        }
+        
+        // parse args
+        std::vector<std::string> args{};
+        std::string arg = "";
+
+        if (instructionType == InstructionType::MSG) {
+            // msg instruction args are parsed differently, because they may include queted text
+            std::string rest = "";
+            std::getline(ss, rest);
+            args = splitQuoted(rest);
+        } else {
+            // all other isntruction types
+            while (ss >> arg) {
+                // remove ',' from the end of the arg if exists
+                arg = arg.back() == ',' ? arg.substr(0, arg.length() - 1) : arg;
+                args.push_back(arg);
+            }
+        }
+
+        // store the parsed instruciton
+        this->instructions.push_back(Interpreter::instruction{instructionType, args});
+    }
+
+    if (defining != nullptr) throw "ERROR::INTERPRETER::UNTERMINATED_MACRO: " + definingName;
+}
+
+void Interpreter::parseDirective(const std::string& name, const std::vector<std::string>& args)
+{
+    // This function handles a directive, a line starting with '.' which describes the linear memory instead of an instruction.
+    //
+    // Key behaviors:
+    // - ".memory size" declares a memory of `size` ints, all 0 at the start of a run. A program declares at most one memory.
+    // - ".data address, value, ..." sets the initial values of consecutive ints starting at `address` of the declared memory.
+    // - ".channel capacity" declares a channel holding at most `capacity` values. Channels are numbered from 0 in the order of declaration.
+
+    std::string line = name;
+    for (size_t i = 0; i < args.size(); ++i) line += (i ? ", " : " ") + args[i];
+    auto toNumber = [&](const std::string& arg) -> long long {
+        if (!this->isConst(arg) || arg.length() > 11) throw "ERROR::INTERPRETER::INVALID_DIRECTIVE: " + line;
+        return std::stoll(arg);
+    };
+
+    if (name == ".memory") {
+        if (args.size() != 1 || !this->memory.empty()) throw "ERROR::INTERPRETER::INVALID_DIRECTIVE: " + line;
+        long long size = toNumber(args[0]);
+        if (size < 1 || size > Bytecode::maxMemorySize) throw "ERROR::INTERPRETER::INVALID_DIRECTIVE: " + line;
+        this->memory.assign(static_cast<size_t>(size), 0);
+    } else if (name == ".channel") {
+        if (args.size() != 1 || this->channelCapacities.size() >= Bytecode::maxChannels) throw "ERROR::INTERPRETER::INVALID_DIRECTIVE: " + line;
+        long long capacity = toNumber(args[0]);
+        if (capacity < 1 || capacity > Bytecode::maxChannelCapacity) throw "ERROR::INTERPRETER::INVALID_DIRECTIVE: " + line;
+        this->channelCapacities.push_back(static_cast<int>(capacity));
+    } else if (name == ".data") {
+        if (args.size() < 2) throw "ERROR::INTERPRETER::INVALID_DIRECTIVE: " + line;
+        long long address = toNumber(args[0]);
+        if (address < 0 || address + static_cast<long long>(args.size()) - 1 > static_cast<long long>(this->memory.size())) {
+            throw "ERROR::INTERPRETER::INVALID_DIRECTIVE: " + line;
+        }
+        for (size_t i = 1; i < args.size(); ++i) {
+            long long value = toNumber(args[i]);
+            if (value < INT32_MIN || value > INT32_MAX) throw "ERROR::INTERPRETER::INVALID_DIRECTIVE: " + line;
+            this->memory[static_cast<size_t>(address) + i - 1] = static_cast<int>(value);
+        }
+    } else {
+        throw "ERROR::INTERPRETER::UNKNOWN_DIRECTIVE: " + name;
+    }
+}
+
+void Interpreter::execute()
+{
+    TraceSpan span("execute");
+    LatencyTimer timer(metrics.executeLatency);
+
+    size_t instructionPointer = 0;
+    std::stack<size_t> call_stack{};
+    uint64_t executedInstructions = 0;
+
+    ProbeScope probeScope{};
+    ExecutionProbe* probe = probeScope.get();
+
+    bool isFinished = false;
+
+    // the program is the task 0, which renders the message; the run is finished once all tasks are
+    this->channels.assign(this->channelCapacities.size(), {});
+    this->tasks.assign(1, Interpreter::task{});
+    size_t current = 0;
+    size_t unfinished = 1;
+    size_t unjoined = 0;
+    // number of tasks which had to wait since the last change of a channel or a task, if all of them had to, none can continue
+    size_t waiting = 0;
+
+    // saves the state of the running task and continues with the next unfinished one
+    auto switchTask = [&]() -> void {
+        auto swapState = [&](Interpreter::task& t) -> void {
+            std::swap(this->regs, t.regs);
+            std::swap(this->cmpResult, t.cmpResult);
+            std::swap(this->memory, t.memory);
+            std::swap(this->dataStack, t.dataStack);
+            std::swap(this->vectors, t.vectors);
+            std::swap(this->messagePattern, t.messagePattern);
+            std::swap(instructionPointer, t.instructionPointer);
+            std::swap(call_stack, t.callStack);
+            std::swap(executedInstructions, t.executedInstructions);
+        };
+        swapState(this->tasks[current]);
+        do {
+            current = (current + 1) % this->tasks.size();
+        } while (this->tasks[current].isFinished);
+        swapState(this->tasks[current]);
+    };
+    auto finishTask = [&]() -> void {
+        this->tasks[current].isFinished = true;
+        waiting = 0;
+        if (--unfinished == 0) {
+            isFinished = true;
+            return;
+        }
+        size_t finished = current;
+        switchTask();
+        // only the flags of a finished task are used
+        this->tasks[finished].regs = {};
+        this->tasks[finished].memory = {};
+        this->tasks[finished].dataStack = {};
+        this->tasks[finished].vectors = {};
+    };
+    // the instruction is executed again once the task continues
+    auto waitForOthers = [&]() -> void {
+        instructionPointer--;
+        executedInstructions--;
+        if (++waiting >= unfinished) throw std::string("ERROR::INTERPRETER::DEADLOCK");
+        switchTask();
+    };
+
+    while (!isFinished) {
+        // check if the running task is finished
+        if (instructionPointer >= this->instructions.size()) {
+            finishTask();
+            continue;
+        }
+
+        if (probe) probe->enter(instructionPointer);
+        Interpreter::instruction& instr = this->instructions[instructionPointer++];
+        if (++executedInstructions > this->instructionLimit) throw "ERROR::INTERPRETER::INSTRUCTION_LIMIT_EXCEEDED: " + std::to_string(this->instructionLimit);
+
+        auto validateArgCount = [&](const size_t desiredSize) -> void {
+            if (instr.args.size() != desiredSize) throw "ERROR::INTERPRETER::INVALID_NUMBER_OF_ARGS: " + std::to_string(instr.args.size());
+        };
+        auto validateFirstArgIsRegister = [&]() -> void {
+            if (!this->isRegister(instr.args[0])) throw "ERROR::INTERPRETER::FIRST_ARG_SHOULD_BE_A_REGISTER: " + instr.args[0];
+        };
+        auto validateArgs = [&](const size_t desiredSize) -> void {
+            validateArgCount(desiredSize);
+            validateFirstArgIsRegister();
+        };
+        auto resolveValue = [&](const std::string& arg) -> int {
+            int val = 0;
+            if (this->isRegister(arg)) {
+                val = this->regs[arg];
+            } else if (this->isConst(arg)) {
+                val = std::stoi(arg);
+            } else {
+                throw "ERROR::INTERPRETER::INVALID_ARG: " + arg;
+            }
+            return val;
+        };
+        auto findSubroutine = [&](const std::string& name) -> size_t {
+            auto it = this->subroutines.find(name);
+            if (it == this->subroutines.end()) {
+                throw "ERROR::INTERPRETER::CAN_NOT_FIND_SUBROUTINE: " + name;
+            }
+            return it->second;
+        };
+        // returns the first lane of a vector register
+        auto findVector = [&](const std::string& arg) -> int* {
+            int index = this->findVectorRegister(arg);
+            if (index < 0) throw "ERROR::INTERPRETER::INVALID_VECTOR_REGISTER: " + arg;
+            return &this->vectors[static_cast<size_t>(index) * Bytecode::vectorLanes];
+        };
+        auto findChannel = [&](const std::string& arg) -> size_t {
+            int index = resolveValue(arg);
+            if (index < 0 || index >= static_cast<int>(this->channels.size())) throw "ERROR::INTERPRETER::INVALID_CHANNEL: " + std::to_string(index);
+            return static_cast<size_t>(index);
+        };
+        // returns the position of `count` ints starting at the address, all of them must be inside the memory
+        auto checkMemory = [&](long long address, long long count) -> size_t {
+            if (count < 0) throw "ERROR::INTERPRETER::INVALID_COUNT: " + std::to_string(count);
+            if (address < 0 || address + count > static_cast<long long>(this->memory.size())) {
+                throw "ERROR::INTERPRETER::MEMORY_OUT_OF_BOUNDS: " + std::to_string(address);
+            }
+            return static_cast<size_t>(address);
+        };
+        
+        switch (instr.type)
+        {
+        case InstructionType::MOV:
+            validateArgs(2);
+            this->regs[instr.args[0]] = resolveValue(instr.args[1]);
+            break;
+        case InstructionType::INC:
+            validateArgs(1);
+            this->regs[instr.args[0]] = wrapAdd(this->regs[instr.args[0]], 1);
+            break;
+        case InstructionType::DEC:
+            validateArgs(1);
+            this->regs[instr.args[0]] = wrapSub(this->regs[instr.args[0]], 1);
+            break;
+        case InstructionType::ADD: {
+            validateArgs(2);
+            int value = resolveValue(instr.args[1]);
+            this->regs[instr.args[0]] = wrapAdd(this->regs[instr.args[0]], value);
+            break;
+        }
+        case InstructionType::SUB: {
+            validateArgs(2);
+            int value = resolveValue(instr.args[1]);
+            this->regs[instr.args[0]] = wrapSub(this->regs[instr.args[0]], value);
+            break;
+        }
+        case InstructionType::MUL: {
+            validateArgs(2);
+            int value = resolveValue(instr.args[1]);
+            this->regs[instr.args[0]] = wrapMul(this->regs[instr.args[0]], value);
+            break;
+        }
+        case InstructionType::DIV: {
+            validateArgs(2);
+            int divisor = resolveValue(instr.args[1]);
+            if (divisor == 0) throw std::string("ERROR::INTERPRETER::DIVISION_BY_ZERO");
+            // the quotient of the smallest int and -1 would overflow, it wraps around like the other arithmetic
+            int& dividend = this->regs[instr.args[0]];
+            dividend = divisor == -1 ? static_cast<int>(0u - static_cast<unsigned>(dividend)) : dividend / divisor;
+            break;
+        }
+        case InstructionType::AND:
+            validateArgs(2);
+            this->regs[instr.args[0]] &= resolveValue(instr.args[1]);
+            break;
+        case InstructionType::OR:
+            validateArgs(2);
+            this->regs[instr.args[0]] |= resolveValue(instr.args[1]);
+            break;
+        case InstructionType::XOR:
+            validateArgs(2);
+            this->regs[instr.args[0]] ^= resolveValue(instr.args[1]);
+            break;
+        case InstructionType::NOT:
+            validateArgs(1);
+            this->regs[instr.args[0]] = ~this->regs[instr.args[0]];
+            break;
+        case InstructionType::SHL: {
+            validateArgs(2);
+            int count = resolveValue(instr.args[1]) & 31;
+            this->regs[instr.args[0]] = static_cast<int>(static_cast<uint32_t>(this->regs[instr.args[0]]) << count);
+            break;
+        }
+        case InstructionType::SHR: {
+            validateArgs(2);
+            int count = resolveValue(instr.args[1]) & 31;
+            this->regs[instr.args[0]] = static_cast<int>(static_cast<uint32_t>(this->regs[instr.args[0]]) >> count);
+            break;
+        }
+        case InstructionType::MOD: {
+            validateArgs(2);
+            int divisor = resolveValue(instr.args[1]);
+            if (divisor == 0) throw std::string("ERROR::INTERPRETER::DIVISION_BY_ZERO");
+            // every number is divisible by -1, the remainder of the smallest int would overflow
+            this->regs[instr.args[0]] = divisor == -1 ? 0 : this->regs[instr.args[0]] % divisor;
+            break;
+        }
+        case InstructionType::LOOP:
+            validateArgs(2);
+            this->cmpResult = this->regs[instr.args[0]] = wrapSub(this->regs[instr.args[0]], 1);
+            if (this->cmpResult != 0) {
+                instructionPointer = findSubroutine(instr.args[1]);
+            }
+            continue;
+        case InstructionType::JNZ:
+            validateArgs(2);
+            this->cmpResult = this->regs[instr.args[0]];
+            if (this->cmpResult != 0) {
+                instructionPointer = findSubroutine(instr.args[1]);
+            }
+            continue;
+        case InstructionType::JZ:
+            validateArgs(2);
+            this->cmpResult = this->regs[instr.args[0]];
+            if (this->cmpResult == 0) {
+                instructionPointer = findSubroutine(instr.args[1]);
+            }
+            continue;
+        case InstructionType::CMOVNE:
+        case InstructionType::CMOVE:
+        case InstructionType::CMOVGE:
+        case InstructionType::CMOVG:
+        case InstructionType::CMOVLE:
+        case InstructionType::CMOVL: {
+            validateArgs(2);
+            // the value is resolved even if it is not moved, so an invalid argument is always reported
+            int value = resolveValue(instr.args[1]);
+            bool isMoved = false;
+            switch (instr.type)
+            {
+            case InstructionType::CMOVNE: isMoved = this->cmpResult != 0; break;
+            case InstructionType::CMOVE: isMoved = this->cmpResult == 0; break;
+            case InstructionType::CMOVGE: isMoved = this->cmpResult >= 0; break;
+            case InstructionType::CMOVG: isMoved = this->cmpResult > 0; break;
+            case InstructionType::CMOVLE: isMoved = this->cmpResult <= 0; break;
+            default: isMoved = this->cmpResult < 0; break;
+            }
+            if (isMoved) this->regs[instr.args[0]] = value;
+            break;
+        }
+        case InstructionType::LOAD: {
+            // load r, address or load r, address, index
+            if (instr.args.size() != 3) validateArgCount(2);
+            validateFirstArgIsRegister();
+            long long address = resolveValue(instr.args[1]);
+            if (instr.args.size() == 3) address += resolveValue(instr.args[2]);
+            this->regs[instr.args[0]] = this->memory[checkMemory(address, 1)];
+            break;
+        }
+        case InstructionType::STORE: {
+            // store address, value or store address, index, value
+            if (instr.args.size() != 3) validateArgCount(2);
+            long long address = resolveValue(instr.args[0]);
+            if (instr.args.size() == 3) address += resolveValue(instr.args[1]);
+            int value = resolveValue(instr.args.back());
+            this->memory[checkMemory(address, 1)] = value;
+            break;
+        }
+        case InstructionType::MEMSET: {
+            validateArgCount(3);
+            long long address = resolveValue(instr.args[0]);
+            int value = resolveValue(instr.args[1]);
+            long long count = resolveValue(instr.args[2]);
+            std::fill_n(this->memory.begin() + static_cast<std::ptrdiff_t>(checkMemory(address, count)), count, value);
+            break;
+        }
+        case InstructionType::MEMCPY: {
+            validateArgCount(3);
+            long long to = resolveValue(instr.args[0]);
+            long long from = resolveValue(instr.args[1]);
+            long long count = resolveValue(instr.args[2]);
+            size_t destination = checkMemory(to, count);
+            size_t source = checkMemory(from, count);
+            if (count > 0) std::memmove(&this->memory[destination], &this->memory[source], static_cast<size_t>(count) * sizeof(int));
+            break;
+        }
+        case InstructionType::PUSH: {
+            if (instr.args.empty()) throw std::string("ERROR::INTERPRETER::INVALID_NUMBER_OF_ARGS: 0");
+            std::vector<int> values{};
+            for (const std::string& arg : instr.args) values.push_back(resolveValue(arg));
+            if (this->dataStack.size() + values.size() > Bytecode::maxStackSize) throw std::string("ERROR::INTERPRETER::STACK_OVERFLOW");
+            this->dataStack.insert(this->dataStack.end(), values.begin(), values.end());
+            break;
+        }
+        case InstructionType::POP:
+            if (instr.args.empty()) throw std::string("ERROR::INTERPRETER::INVALID_NUMBER_OF_ARGS: 0");
+            for (const std::string& arg : instr.args) {
+                if (!this->isRegister(arg)) throw "ERROR::INTERPRETER::INVALID_ARG: " + arg;
+            }
+            if (this->dataStack.size() < instr.args.size()) throw std::string("ERROR::INTERPRETER::STACK_UNDERFLOW");
+            for (size_t i = instr.args.size(); i > 0; --i) {
+                this->regs[instr.args[i - 1]] = this->dataStack.back();
+                this->dataStack.pop_back();
+            }
+            break;
+        case InstructionType::VMOV:
+        case InstructionType::VADD:
+        case InstructionType::VSUB:
+        case InstructionType::VMUL:
+        case InstructionType::VMIN:
+        case InstructionType::VMAX:
+        case InstructionType::VCMPEQ:
+        case InstructionType::VCMPGT: {
+            validateArgCount(2);
+            int* destination = findVector(instr.args[0]);
+            const int* source = findVector(instr.args[1]);
+            for (size_t i = 0; i < Bytecode::vectorLanes; ++i) {
+                // lanes wrap around on overflow
+                uint32_t a = static_cast<uint32_t>(destination[i]);
+                uint32_t b = static_cast<uint32_t>(source[i]);
+                switch (instr.type)
+                {
+                case InstructionType::VMOV: a = b; break;
+                case InstructionType::VADD: a += b; break;
+                case InstructionType::VSUB: a -= b; break;
+                case InstructionType::VMUL: a *= b; break;
+                case InstructionType::VMIN: a = std::min(destination[i], source[i]); break;
+                case InstructionType::VMAX: a = std::max(destination[i], source[i]); break;
+                case InstructionType::VCMPEQ: a = destination[i] == source[i] ? UINT32_MAX : 0; break;
+                default: a = destination[i] > source[i] ? UINT32_MAX : 0; break;
+                }
+                destination[i] = static_cast<int>(a);
+            }
+            break;
+        }
+        case InstructionType::VSET: {
+            validateArgCount(2);
+            int* destination = findVector(instr.args[0]);
+            int value = resolveValue(instr.args[1]);
+            for (size_t i = 0; i < Bytecode::vectorLanes; ++i) destination[i] = value;
+            break;
+        }
+        case InstructionType::VHSUM:
+        case InstructionType::VHMIN:
+        case InstructionType::VHMAX: {
+            validateArgs(2);
+            const int* source = findVector(instr.args[1]);
+            uint32_t sum = 0;
+            int smallest = source[0];
+            int greatest = source[0];
+            for (size_t i = 0; i < Bytecode::vectorLanes; ++i) {
+                sum += static_cast<uint32_t>(source[i]);
+                smallest = std::min(smallest, source[i]);
+                greatest = std::max(greatest, source[i]);
+            }
+            if (instr.type == InstructionType::VHSUM) this->regs[instr.args[0]] = static_cast<int>(sum);
+            else this->regs[instr.args[0]] = instr.type == InstructionType::VHMIN ? smallest : greatest;
+            break;
+        }
+        case InstructionType::VLOAD: {
+            // vload v, address or vload v, address, index
+            if (instr.args.size() != 3) validateArgCount(2);
+            int* destination = findVector(instr.args[0]);
+            long long address = resolveValue(instr.args[1]);
+            if (instr.args.size() == 3) address += resolveValue(instr.args[2]);
+            size_t position = checkMemory(address, Bytecode::vectorLanes);
+            for (size_t i = 0; i < Bytecode::vectorLanes; ++i) destination[i] = this->memory[position + i];
+            break;
+        }
+        case InstructionType::VSTORE: {
+            // vstore address, v or vstore address, index, v
+            if (instr.args.size() != 3) validateArgCount(2);
+            long long address = resolveValue(instr.args[0]);
+            if (instr.args.size() == 3) address += resolveValue(instr.args[1]);
+            const int* source = findVector(instr.args.back());
+            size_t position = checkMemory(address, Bytecode::vectorLanes);
+            for (size_t i = 0; i < Bytecode::vectorLanes; ++i) this->memory[position + i] = source[i];
+            break;
+        }
+        case InstructionType::SYSCALL: {
+            // syscall r, name, args...
+            if (instr.args.size() < 2) throw "ERROR::INTERPRETER::INVALID_NUMBER_OF_ARGS: " + std::to_string(instr.args.size());
+            validateFirstArgIsRegister();
+            int arity = 0;
+            NativeFunction function = NativeFunctions::find(instr.args[1], arity);
+            if (!function) throw "ERROR::INTERPRETER::UNKNOWN_FUNCTION: " + instr.args[1];
+            size_t count = instr.args.size() - 2;
+            if (arity < 0 ? count == 0 || count > NativeFunctions::maxArguments : count != static_cast<size_t>(arity)) {
+                throw "ERROR::INTERPRETER::INVALID_NUMBER_OF_ARGS: " + std::to_string(instr.args.size());
+            }
+            std::vector<int> values{};
+            for (size_t i = 2; i < instr.args.size(); ++i) values.push_back(resolveValue(instr.args[i]));
+            this->regs[instr.args[0]] = function(values.data(), values.size());
+            break;
+        }
+        case InstructionType::SPAWN: {
+            validateArgs(2);
+            size_t position = findSubroutine(instr.args[1]);
+            if (unjoined >= Bytecode::maxTasks) throw std::string("ERROR::INTERPRETER::TOO_MANY_TASKS");
+            this->regs[instr.args[0]] = static_cast<int>(this->tasks.size());
+            Interpreter::task t{};
+            t.regs = this->regs;
+            t.memory = this->memory;
+            t.vectors = std::vector<int>(Bytecode::vectorRegisters * Bytecode::vectorLanes, 0);
+            t.instructionPointer = position;
+            this->tasks.push_back(std::move(t));
+            unfinished++;
+            unjoined++;
+            waiting = 0;
+            break;
+        }
+        case InstructionType::JOIN: {
+            validateArgs(1);
+            int id = this->regs[instr.args[0]];
+            if (id < 1 || id >= static_cast<int>(this->tasks.size())) throw "ERROR::INTERPRETER::INVALID_TASK: " + std::to_string(id);
+            if (!this->tasks[id].isFinished) {
+                waitForOthers();
+                continue;
+            }
+            if (!this->tasks[id].isJoined) {
+                this->tasks[id].isJoined = true;
+                unjoined--;
+            }
+            waiting = 0;
+            break;
+        }
+        case InstructionType::SEND: {
+            validateArgCount(2);
+            size_t index = findChannel(instr.args[0]);
+            int value = resolveValue(instr.args[1]);
+            if (this->channels[index].size() >= static_cast<size_t>(this->channelCapacities[index])) {
+                waitForOthers();
+                continue;
+            }
+            this->channels[index].push_back(value);
+            waiting = 0;
+            break;
+        }
+        case InstructionType::RECV: {
+            validateArgs(2);
+            size_t index = findChannel(instr.args[1]);
+            if (this->channels[index].empty()) {
+                waitForOthers();
+                continue;
+            }
+            this->regs[instr.args[0]] = this->channels[index].front();
+            this->channels[index].pop_front();
+            waiting = 0;
+            break;
+        }
+        case InstructionType::JTAB: {
+            if (instr.args.size() < 2) throw "ERROR::INTERPRETER::INVALID_NUMBER_OF_ARGS: " + std::to_string(instr.args.size());
+            validateFirstArgIsRegister();
+            // every label is checked, not only the selected one
+            int index = this->regs[instr.args[0]];
+            for (size_t i = 1; i < instr.args.size(); ++i) {
+                size_t position = findSubroutine(instr.args[i]);
+                if (index == static_cast<int>(i - 1)) instructionPointer = position;
+            }
+            continue;
+        }
+        case InstructionType::JMP:
+            validateArgCount(1);
+            instructionPointer = findSubroutine(instr.args[0]);
+            continue;
+        case InstructionType::CMP:
+            validateArgCount(2);
+            this->cmpResult = compareValues(resolveValue(instr.args[0]), resolveValue(instr.args[1]));
+            break;
+        case InstructionType::JNE:
+            validateArgCount(1);
+            if (this->cmpResult != 0) {
+                instructionPointer = findSubroutine(instr.args[0]);
+            }
+            continue;
+        case InstructionType::JE:
+            validateArgCount(1);
+            if (this->cmpResult == 0) {
+                instructionPointer = findSubroutine(instr.args[0]);
+            }
+            continue;
+        case InstructionType::JGE:
+            validateArgCount(1);
+            if (this->cmpResult >= 0) {
+                instructionPointer = findSubroutine(instr.args[0]);
+            }
+            continue;
+        case InstructionType::JG:
+            validateArgCount(1);
+            if (this->cmpResult > 0) {
+                instructionPointer = findSubroutine(instr.args[0]);
+            }
+            continue;
+        case InstructionType::JLE:
+            validateArgCount(1);
+            if (this->cmpResult <= 0) {
+                instructionPointer = findSubroutine(instr.args[0]);
+            }
+            continue;
+        case InstructionType::JL:
+            validateArgCount(1);
+            if (this->cmpResult < 0) {
+                instructionPointer = findSubroutine(instr.args[0]);
+            }
+            continue;
+        case InstructionType::CALL:
+            validateArgCount(1);
+            if (call_stack.size() >= Bytecode::maxCallDepth) throw std::string("ERROR::INTERPRETER::CALL_STACK_OVERFLOW");
+            call_stack.push(instructionPointer);
+            instructionPointer = findSubroutine(instr.args[0]);
+            if (probe) probe->call(instructionPointer, call_stack.size());
+            break;
+        case InstructionType::MSG:
+            this->messagePattern = instr.args;
+            break;
+        case InstructionType::RET:
+            if (call_stack.empty()) throw std::string("ERROR::INTERPRETER::RET_WITHOUT_CALL");
+            instructionPointer = call_stack.top();
+            call_stack.pop();
+            if (probe) probe->ret(call_stack.size());
+            break;
+        case InstructionType::END:
+            // only the message of the program is output
+            if (current == 0) this->createMessage();
+            finishTask();
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+void Interpreter::createMessage()
+{
+    TraceSpan span("render message");
+
+    if (this->messagePattern.empty()) {
+        // default output
+        this->output = "-1";
+        return;
+    }
+
+    this->output = "";
+    for (std::string a : this->messagePattern) {
+        if (a.at(0) == '\'') {
+            // quoted text
+            this->output += a.substr(1, a.length() - 2);
+        } else if (this->isRegister(a)) {
+            // register value
+            this->output += std::to_string(this->regs[a]);
+        } else {
+            throw "ERROR::INTERPRETER::INVALID_MSG_ARGUMENT: " + a;
+        }
+    }
+}
+
+// constructor
+Interpreter::Interpreter (const std::string& program)
+    : Interpreter(program, {})
+{
+}
+
+Interpreter::Interpreter (const std::string& program, const std::vector<std::pair<std::string, int>>& registers, uint64_t instructionLimit)
+    : program(program)
+{
+    this->initVariables();
+    this->instructionLimit = instructionLimit;
+    for (const auto& reg : registers) this->regs[reg.first] = reg.second;
+    try {
+        this->parseProgram();
+        this->execute();
+    } catch (const std::string& e) {
+        if (isMetricsEnabled) metrics.recordFault(e);
+        throw;
+    }
+}
+
+// accessors
+const std::string& Interpreter::getOutput() const {
+    return this->output;
+};
+
+// native functions
+int nativeAbs(const int* args, size_t)
+{
+    // the absolute value of the smallest int wraps around to itself
+    return args[0] < 0 ? static_cast<int>(0u - static_cast<uint32_t>(args[0])) : args[0];
+}
+
+int nativeGcd(const int* args, size_t)
+{
+    uint32_t a = static_cast<uint32_t>(nativeAbs(&args[0], 1));
+    uint32_t b = static_cast<uint32_t>(nativeAbs(&args[1], 1));
+    while (b != 0) {
+        uint32_t r = a % b;
+        a = b;
+        b = r;
+    }
+    return static_cast<int>(a);
+}
+
+int nativePow(const int* args, size_t)
+{
+    // the result wraps around on overflow like MUL
+    if (args[1] < 0) throw "ERROR::INTERPRETER::NEGATIVE_EXPONENT: " + std::to_string(args[1]);
+    uint32_t base = static_cast<uint32_t>(args[0]);
+    uint32_t result = 1;
+    for (uint32_t exponent = static_cast<uint32_t>(args[1]); exponent > 0; exponent >>= 1) {
+        if (exponent & 1) result *= base;
+        base *= base;
+    }
+    return static_cast<int>(result);
+}
+
+int nativeMin(const int* args, size_t count)
+{
+    return *std::min_element(args, args + count);
+}
+
+int nativeMax(const int* args, size_t count)
+{
+    return *std::max_element(args, args + count);
+}
+
+int nativeHash(const int* args, size_t count)
+{
+    // 32-bit FNV-1a of the bytes of the values, from the lowest one
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < count; ++i) {
+        for (int shift = 0; shift < 32; shift += 8) {
+            hash ^= (static_cast<uint32_t>(args[i]) >> shift) & 0xff;
+            hash *= 16777619u;
+        }
+    }
+    return static_cast<int>(hash);
+}
+
+std::mutex NativeFunctions::registryMutex;
+std::unordered_map<std::string, NativeFunctions::entry> NativeFunctions::registry{
+    { "abs", { nativeAbs, 1 } },
+    { "gcd", { nativeGcd, 2 } },
+    { "pow", { nativePow, 2 } },
+    { "min", { nativeMin, -1 } },
+    { "max", { nativeMax, -1 } },
+    { "hash", { nativeHash, -1 } }
+};
+
+void NativeFunctions::add(const std::string& name, NativeFunction function, int arity)
+{
+    if (!function || arity < -1 || arity > static_cast<int>(NativeFunctions::maxArguments)) throw "ERROR::NATIVE::INVALID_FUNCTION: " + name;
+    std::lock_guard<std::mutex> lock(NativeFunctions::registryMutex);
+    NativeFunctions::registry[name] = {function, arity};
+}
+
+NativeFunction NativeFunctions::find(const std::string& name, int& arity)
+{
+    std::lock_guard<std::mutex> lock(NativeFunctions::registryMutex);
+    auto it = NativeFunctions::registry.find(name);
+    if (it == NativeFunctions::registry.end()) return nullptr;
+    arity = it->second.arity;
+    return it->second.function;
+}
+
+std::vector<std::pair<std::string, int>> NativeFunctions::list()
+{
+    std::lock_guard<std::mutex> lock(NativeFunctions::registryMutex);
+    std::vector<std::pair<std::string, int>> functions{};
+    for (const auto& function : NativeFunctions::registry) functions.push_back({function.first, function.second.arity});
+    std::sort(functions.begin(), functions.end());
+    return functions;
+}
+
+// bytecode
+Bytecode Interpreter::link() const
+{
+    // This function converts the parsed instructions into bytecode executed by BytecodeEngine.
+    // Every register gets a slot, constants are converted to integers and labels to positions in the program.
+    //
+    // Key behaviors:
+    // - Instructions are converted one to one, so positions of labels do not change.
+    // - Invalid instructions are not rejected. They are compiled into ops throwing the same error as `execute()`, once they are reached.
+
+    TraceSpan span("link");
+    LatencyTimer timer(metrics.linkLatency);
+
+    Bytecode bytecode{};
+    bytecode.labels = this->subroutines;
+    bytecode.memory = this->memory;
+    bytecode.channels = this->channelCapacities;
+
+    std::unordered_map<std::string, int> slots{};
+    auto slotOf = [&](const std::string& name) -> int {
+        auto it = slots.find(name);
+        if (it != slots.end()) return it->second;
+        int slot = static_cast<int>(bytecode.registerNames.size());
+        bytecode.registerNames.push_back(name);
+        slots[name] = slot;
+        return slot;
+    };
+    auto addFault = [&](const std::string& error) -> int {
+        bytecode.faults.push_back(error);
+        return static_cast<int>(bytecode.faults.size() - 1);
+    };
+
+    for (const Interpreter::instruction& instr : this->instructions) {
+        Bytecode::op op{instr.type, {false, 0}, {false, 0}, {false, 0}, -1, -1};
+
+        auto fail = [&](const std::string& error) -> bool {
+            op.type = InstructionType::NONE;
+            op.fault = addFault(error);
+            return false;
+        };
+        // the checks below are made in the same order as in execute(), so the first error is reported
+        auto checkArgCount = [&](const size_t desiredSize) -> bool {
+            if (instr.args.size() != desiredSize) return fail("ERROR::INTERPRETER::INVALID_NUMBER_OF_ARGS: " + std::to_string(instr.args.size()));
+            return true;
+        };
+        auto checkArgs = [&](const size_t desiredSize) -> bool {
+            if (!checkArgCount(desiredSize)) return false;
+            if (!this->isRegister(instr.args[0])) return fail("ERROR::INTERPRETER::FIRST_ARG_SHOULD_BE_A_REGISTER: " + instr.args[0]);
+            op.dst = {true, slotOf(instr.args[0])};
+            return true;
+        };
+        auto resolveValue = [&](const std::string& arg, Bytecode::operand& operand) -> bool {
+            if (this->isRegister(arg)) {
+                operand = {true, slotOf(arg)};
+                return true;
+            }
+            if (this->isConst(arg)) {
+                try {
+                    operand = {false, std::stoi(arg)};
+                    return true;
+                } catch (const std::out_of_range&) {}
+            }
+            return fail("ERROR::INTERPRETER::INVALID_ARG: " + arg);
+        };
+        auto resolveVector = [&](const std::string& arg, Bytecode::operand& operand) -> bool {
+            int index = this->findVectorRegister(arg);
+            if (index < 0) return fail("ERROR::INTERPRETER::INVALID_VECTOR_REGISTER: " + arg);
+            operand = {false, index};
+            return true;
+        };
+        auto resolveLabel = [&](const std::string& name) -> void {
+            auto it = this->subroutines.find(name);
+            if (it == this->subroutines.end()) {
+                op.fault = addFault("ERROR::INTERPRETER::CAN_NOT_FIND_SUBROUTINE: " + name);
+            } else {
+                op.target = static_cast<int>(it->second);
+            }
+        };
+
+        switch (instr.type)
+        {
+        case InstructionType::MOV:
+        case InstructionType::ADD:
+        case InstructionType::SUB:
+        case InstructionType::MUL:
+        case InstructionType::DIV:
+        case InstructionType::AND:
+        case InstructionType::OR:
+        case InstructionType::XOR:
+        case InstructionType::SHL:
+        case InstructionType::SHR:
+        case InstructionType::MOD:
+        case InstructionType::CMOVNE:
+        case InstructionType::CMOVE:
+        case InstructionType::CMOVGE:
+        case InstructionType::CMOVG:
+        case InstructionType::CMOVLE:
+        case InstructionType::CMOVL:
+        case InstructionType::RECV:
+            if (checkArgs(2)) resolveValue(instr.args[1], op.src);
+            break;
+        case InstructionType::INC:
+        case InstructionType::DEC:
+        case InstructionType::NOT:
+        case InstructionType::JOIN:
+            checkArgs(1);
+            break;
+        case InstructionType::CMP:
+        case InstructionType::SEND:
+            if (checkArgCount(2) && resolveValue(instr.args[0], op.dst)) resolveValue(instr.args[1], op.src);
+            break;
+        case InstructionType::JMP:
+        case InstructionType::JNE:
+        case InstructionType::JE:
+        case InstructionType::JGE:
+        case InstructionType::JG:
+        case InstructionType::JLE:
+        case InstructionType::JL:
+        case InstructionType::CALL:
+            if (checkArgCount(1)) resolveLabel(instr.args[0]);
+            break;
+        case InstructionType::LOOP:
+        case InstructionType::JNZ:
+        case InstructionType::JZ:
+        case InstructionType::SPAWN:
+            if (checkArgs(2)) resolveLabel(instr.args[1]);
+            break;
+        case InstructionType::LOAD:
+            if (instr.args.size() == 3 ? checkArgs(3) : checkArgs(2)) {
+                if (resolveValue(instr.args[1], op.src) && instr.args.size() == 3) resolveValue(instr.args[2], op.extra);
+            }
+            break;
+        case InstructionType::STORE:
+            if (instr.args.size() == 3 || checkArgCount(2)) {
+                if (resolveValue(instr.args[0], op.dst) && (instr.args.size() == 2 || resolveValue(instr.args[1], op.extra))) resolveValue(instr.args.back(), op.src);
+            }
+            break;
+        case InstructionType::MEMSET:
+        case InstructionType::MEMCPY:
+            if (checkArgCount(3) && resolveValue(instr.args[0], op.dst) && resolveValue(instr.args[1], op.src)) resolveValue(instr.args[2], op.extra);
+            break;
+        case InstructionType::VMOV:
+        case InstructionType::VADD:
+        case InstructionType::VSUB:
+        case InstructionType::VMUL:
+        case InstructionType::VMIN:
+        case InstructionType::VMAX:
+        case InstructionType::VCMPEQ:
+        case InstructionType::VCMPGT:
+            if (checkArgCount(2) && resolveVector(instr.args[0], op.dst)) resolveVector(instr.args[1], op.src);
+            break;
+        case InstructionType::VSET:
+            if (checkArgCount(2) && resolveVector(instr.args[0], op.dst)) resolveValue(instr.args[1], op.src);
+            break;
+        case InstructionType::VHSUM:
+        case InstructionType::VHMIN:
+        case InstructionType::VHMAX:
+            if (checkArgs(2)) resolveVector(instr.args[1], op.src);
+            break;
+        case InstructionType::VLOAD:
+            if (instr.args.size() == 3 || checkArgCount(2)) {
+                if (resolveVector(instr.args[0], op.dst) && resolveValue(instr.args[1], op.src) && instr.args.size() == 3) resolveValue(instr.args[2], op.extra);
+            }
+            break;
+        case InstructionType::VSTORE:
+            if (instr.args.size() == 3 || checkArgCount(2)) {
+                if (resolveValue(instr.args[0], op.dst) && (instr.args.size() == 2 || resolveValue(instr.args[1], op.extra))) resolveVector(instr.args.back(), op.src);
+            }
+            break;
+        case InstructionType::PUSH:
+        case InstructionType::POP: {
+            if (instr.args.empty()) {
+                fail("ERROR::INTERPRETER::INVALID_NUMBER_OF_ARGS: 0");
+                break;
+            }
+            std::vector<Bytecode::operand> operands(instr.args.size(), {false, 0});
+            for (size_t i = 0; i < instr.args.size(); ++i) {
+                if (instr.type == InstructionType::POP && !this->isRegister(instr.args[i])) {
+                    fail("ERROR::INTERPRETER::INVALID_ARG: " + instr.args[i]);
+                    break;
+                }
+                if (!resolveValue(instr.args[i], operands[i])) break;
+            }
+            if (op.type == InstructionType::NONE) break;
+            bytecode.stackOperands.push_back(operands);
+            op.target = static_cast<int>(bytecode.stackOperands.size() - 1);
+            break;
+        }
+        case InstructionType::SYSCALL: {
+            if (instr.args.size() < 2) {
+                fail("ERROR::INTERPRETER::INVALID_NUMBER_OF_ARGS: " + std::to_string(instr.args.size()));
+                break;
+            }
+            if (!checkArgs(instr.args.size())) break;
+            Bytecode::nativeCall call{instr.args[1], nullptr, {}};
+            int arity = 0;
+            call.function = NativeFunctions::find(call.name, arity);
+            size_t count = instr.args.size() - 2;
+            if (!call.function) {
+                fail("ERROR::INTERPRETER::UNKNOWN_FUNCTION: " + call.name);
+                break;
+            }
+            if (arity < 0 ? count == 0 || count > NativeFunctions::maxArguments : count != static_cast<size_t>(arity)) {
+                fail("ERROR::INTERPRETER::INVALID_NUMBER_OF_ARGS: " + std::to_string(instr.args.size()));
+                break;
+            }
+            call.args.assign(count, {false, 0});
+            for (size_t i = 0; i < count; ++i) {
+                if (!resolveValue(instr.args[i + 2], call.args[i])) break;
+            }
+            if (op.type == InstructionType::NONE) break;
+            bytecode.nativeCalls.push_back(call);
+            op.target = static_cast<int>(bytecode.nativeCalls.size() - 1);
+            break;
+        }
+        case InstructionType::JTAB: {
+            if (instr.args.size() < 2) {
+                fail("ERROR::INTERPRETER::INVALID_NUMBER_OF_ARGS: " + std::to_string(instr.args.size()));
+                break;
+            }
+            if (!checkArgs(instr.args.size())) break;
+            std::vector<int> table{};
+            for (size_t i = 1; i < instr.args.size(); ++i) {
+                auto it = this->subroutines.find(instr.args[i]);
+                if (it == this->subroutines.end()) {
+                    fail("ERROR::INTERPRETER::CAN_NOT_FIND_SUBROUTINE: " + instr.args[i]);
+                    break;
+                }
+                table.push_back(static_cast<int>(it->second));
+            }
+            if (op.type != InstructionType::JTAB) break;
+            bytecode.tables.push_back(table);
+            op.target = static_cast<int>(bytecode.tables.size() - 1);
+            break;
+        }
+        case InstructionType::MSG: {
+            std::vector<Bytecode::messagePart> parts{};
+            for (const std::string& a : instr.args) {
+                if (!a.empty() && a.at(0) == '\'') {
+                    parts.push_back({Bytecode::messagePart::TEXT, a.substr(1, a.length() - 2), -1});
+                } else if (!a.empty() && this->isRegister(a)) {
+                    parts.push_back({Bytecode::messagePart::REGISTER, "", slotOf(a)});
+                } else {
+                    parts.push_back({Bytecode::messagePart::INVALID, a, -1});
+                }
+            }
+            bytecode.messages.push_back(parts);
+            op.target = static_cast<int>(bytecode.messages.size() - 1);
+            break;
+        }
+        default:
+            break;
+        }
+
+        bytecode.code.push_back(op);
+    }
+
+    return bytecode;
+}
+
+Bytecode Interpreter::compile(const std::string& program, bool isOptimized)
+{
+    Interpreter interpreter{};
+    interpreter.program = program;
+    interpreter.initVariables();
+    try {
+        interpreter.parseProgram();
+    } catch (const std::string& e) {
+        if (isMetricsEnabled) metrics.recordFault(e);
+        throw;
+    }
+    Bytecode bytecode = interpreter.link();
+    if (isOptimized) bytecode.optimize();
+    return bytecode;
+}
+
+void Bytecode::optimize()
+{
+    // This function rewrites short patterns of ops into ops which do the same work with fewer dispatches and jumps.
+    // The replaced ops stay in place for jumps to their labels, the new op skips them.
+    //
+    // Key behaviors:
+    // - "dec r / cmp r, k / jne label" becomes a DECJNE op, which runs all three at once.
+    // - A conditional jump over "mov r, x" (if) or over "mov r, x / jmp end" to "mov r, y" (if ... else) becomes a CMOVcc op
+    //   of the same condition with the position after the region as target. It moves the value of the path the jump takes
+    //   (r itself or y) or otherwise x, so data dependent conditions do not cause mispredicted jumps.
+    // - The new ops count the instructions and record the jumps of the replaced ones, so limits, traces and profiles do not change.
+
+    TraceSpan span("optimize");
+
+    for (size_t i = 0; i + 2 < this->code.size(); ++i) {
+        op& dec = this->code[i];
+        const op& cmp = this->code[i + 1];
+        const op& jne = this->code[i + 2];
+        if (dec.type != InstructionType::DEC || cmp.type != InstructionType::CMP || jne.type != InstructionType::JNE) continue;
+        if (!cmp.dst.isRegister || cmp.dst.value != dec.dst.value || jne.target < 0) continue;
+
+        dec = {InstructionType::DECJNE, dec.dst, cmp.src, {false, 0}, jne.target, -1};
+    }
+
+    for (size_t i = 0; i + 1 < this->code.size(); ++i) {
+        op& jump = this->code[i];
+        const op& then = this->code[i + 1];
+        if (jump.type < InstructionType::JNE || jump.type > InstructionType::JL || then.type != InstructionType::MOV) continue;
+        InstructionType move = static_cast<InstructionType>(jump.type - InstructionType::JNE + InstructionType::CMOVNE);
+
+        if (jump.target == static_cast<int>(i + 2)) {
+            jump = {move, then.dst, then.dst, {false, 0}, jump.target, -1};
+        } else if (jump.target == static_cast<int>(i + 3) && i + 3 < this->code.size()) {
+            const op& end = this->code[i + 2];
+            const op& otherwise = this->code[i + 3];
+            if (end.type != InstructionType::JMP || end.target != static_cast<int>(i + 4)) continue;
+            if (otherwise.type != InstructionType::MOV || otherwise.dst.value != then.dst.value) continue;
+            jump = {move, then.dst, otherwise.src, {false, 0}, end.target, -1};
+        }
+    }
+}
+
+int Bytecode::findRegister(const std::string& name) const
+{
+    for (size_t i = 0; i < this->registerNames.size(); ++i) {
+        if (this->registerNames[i] == name) return static_cast<int>(i);
+    }
+    return -1;
+}
+
+std::string Bytecode::serialize() const
+{
+    // This function encodes the bytecode as text, so it can be sent to another process (see the coordinator/worker mode).
+    // Numbers are written as decimal values separated by spaces. Strings are prefixed with their length: "<length>:<bytes>".
+
+    std::ostringstream out;
+    auto writeString = [&](const std::string& str) -> void {
+        out << str.length() << ':' << str << ' ';
+    };
+
+    out << "BYTECODE6 " << this->registerNames.size() << ' ';
+    for (const std::string& name : this->registerNames) writeString(name);
+
+    out << this->labels.size() << ' ';
+    for (const auto& label : this->labels) {
+        writeString(label.first);
+        out << label.second << ' ';
+    }
+
+    out << this->faults.size() << ' ';
+    for (const std::string& fault : this->faults) writeString(fault);
+
+    out << this->messages.size() << ' ';
+    for (const std::vector<Bytecode::messagePart>& parts : this->messages) {
+        out << parts.size() << ' ';
+        for (const Bytecode::messagePart& part : parts) {
+            out << part.kind << ' ' << part.slot << ' ';
+            writeString(part.text);
+        }
+    }
+
+    out << this->tables.size() << ' ';
+    for (const std::vector<int>& table : this->tables) {
+        out << table.size() << ' ';
+        for (int position : table) out << position << ' ';
+    }
+
+    out << this->stackOperands.size() << ' ';
+    for (const std::vector<Bytecode::operand>& operands : this->stackOperands) {
+        out << operands.size() << ' ';
+        for (const Bytecode::operand& operand : operands) out << operand.isRegister << ' ' << operand.value << ' ';
+    }
+
+    // functions are written by name and bound again when the bytecode is decoded
+    out << this->nativeCalls.size() << ' ';
+    for (const Bytecode::nativeCall& call : this->nativeCalls) {
+        writeString(call.name);
+        out << call.args.size() << ' ';
+        for (const Bytecode::operand& operand : call.args) out << operand.isRegister << ' ' << operand.value << ' ';
+    }
+
+    out << this->channels.size() << ' ';
+    for (int capacity : this->channels) out << capacity << ' ';
+
+    // most of the memory is usually 0, so only the other ints are written
+    size_t nonZero = static_cast<size_t>(std::count_if(this->memory.begin(), this->memory.end(), [](int value) { return value != 0; }));
+    out << this->memory.size() << ' ' << nonZero << ' ';
+    for (size_t i = 0; i < this->memory.size(); ++i) {
+        if (this->memory[i] != 0) out << i << ' ' << this->memory[i] << ' ';
+    }
+
+    out << this->code.size() << ' ';
+    for (const Bytecode::op& op : this->code) {
+        out << op.type << ' '
+            << op.dst.isRegister << ' ' << op.dst.value << ' '
+            << op.src.isRegister << ' ' << op.src.value << ' '
+            << op.extra.isRegister << ' ' << op.extra.value << ' '
+            << op.target << ' ' << op.fault << ' ';
+    }
+
+    return out.str();
+}
+
+Bytecode Bytecode::deserialize(const std::string& data)
+{
+    // This function decodes bytecode produced by `serialize()`.
+    // All slots, positions and indices are validated, so decoded bytecode can not make the engine access memory out of range.
+
+    std::istringstream in(data);
+    Bytecode bytecode{};
+
+    auto invalid = [](const std::string& reason) -> std::string {
+        return "ERROR::BYTECODE::INVALID_FORMAT: " + reason;
+    };
+    auto readNumber = [&](long long min, long long max) -> long long {
+        long long value = 0;
+        if (!(in >> value) || value < min || value > max) throw invalid("number out of range");
+        return value;
+    };
+    auto readString = [&]() -> std::string {
+        size_t length = static_cast<size_t>(readNumber(0, static_cast<long long>(data.length())));
+        if (in.get() != ':') throw invalid("string length");
+        std::string str(length, '\0');
+        if (length > 0 && !in.read(&str[0], static_cast<std::streamsize>(length))) throw invalid("string");
+        return str;
+    };
+
+    std::string magic = "";
+    if (!(in >> magic) || magic != "BYTECODE6") throw invalid("header");
+
+    const long long maxCount = static_cast<long long>(data.length());
+    const long long intMin = -2147483648LL;
+    const long long intMax = 2147483647LL;
+
+    for (long long i = readNumber(0, maxCount); i > 0; --i) bytecode.registerNames.push_back(readString());
+
+    std::vector<std::pair<std::string, size_t>> labels{};
+    for (long long i = readNumber(0, maxCount); i > 0; --i) {
+        std::string name = readString();
+        labels.push_back({name, static_cast<size_t>(readNumber(0, maxCount))});
+    }
+
+    for (long long i = readNumber(0, maxCount); i > 0; --i) bytecode.faults.push_back(readString());
+
+    const long long registerCount = static_cast<long long>(bytecode.registerNames.size());
+    for (long long i = readNumber(0, maxCount); i > 0; --i) {
+        std::vector<Bytecode::messagePart> parts{};
+        for (long long j = readNumber(0, maxCount); j > 0; --j) {
+            Bytecode::messagePart part{};
+            part.kind = static_cast<Bytecode::messagePart::Kind>(readNumber(Bytecode::messagePart::TEXT, Bytecode::messagePart::INVALID));
+            part.slot = static_cast<int>(readNumber(-1, registerCount - 1));
+            part.text = readString();
+            if (part.kind == Bytecode::messagePart::REGISTER && part.slot < 0) throw invalid("message register");
+            parts.push_back(part);
+        }
+        bytecode.messages.push_back(parts);
+    }
+
+    for (long long i = readNumber(0, maxCount); i > 0; --i) {
+        std::vector<int> table{};
+        for (long long j = readNumber(0, maxCount); j > 0; --j) table.push_back(static_cast<int>(readNumber(0, intMax)));
+        bytecode.tables.push_back(table);
+    }
+
+    for (long long i = readNumber(0, maxCount); i > 0; --i) {
+        std::vector<Bytecode::operand> operands{};
+        for (long long j = readNumber(1, maxCount); j > 0; --j) {
+            Bytecode::operand operand{};
+            operand.isRegister = readNumber(0, 1) != 0;
+            operand.value = static_cast<int>(operand.isRegister ? readNumber(0, registerCount - 1) : readNumber(intMin, intMax));
+            operands.push_back(operand);
+        }
+        bytecode.stackOperands.push_back(operands);
+    }
+
+    for (long long i = readNumber(0, maxCount); i > 0; --i) {
+        Bytecode::nativeCall call{readString(), nullptr, {}};
+        int arity = 0;
+        call.function = NativeFunctions::find(call.name, arity);
+        if (!call.function) throw "ERROR::BYTECODE::UNKNOWN_FUNCTION: " + call.name;
+        for (long long j = readNumber(1, static_cast<long long>(NativeFunctions::maxArguments)); j > 0; --j) {
+            Bytecode::operand operand{};
+            operand.isRegister = readNumber(0, 1) != 0;
+            operand.value = static_cast<int>(operand.isRegister ? readNumber(0, registerCount - 1) : readNumber(intMin, intMax));
+            call.args.push_back(operand);
+        }
+        if (arity >= 0 && call.args.size() != static_cast<size_t>(arity)) throw invalid("native call arguments");
+        bytecode.nativeCalls.push_back(call);
+    }
+
+    for (long long i = readNumber(0, static_cast<long long>(Bytecode::maxChannels)); i > 0; --i) {
+        bytecode.channels.push_back(static_cast<int>(readNumber(1, Bytecode::maxChannelCapacity)));
+    }
+
+    bytecode.memory.assign(static_cast<size_t>(readNumber(0, Bytecode::maxMemorySize)), 0);
+    for (long long i = readNumber(0, static_cast<long long>(bytecode.memory.size())); i > 0; --i) {
+        size_t address = static_cast<size_t>(readNumber(0, static_cast<long long>(bytecode.memory.size()) - 1));
+        bytecode.memory[address] = static_cast<int>(readNumber(intMin, intMax));
+    }
+
+    long long codeSize = readNumber(0, maxCount);
+    for (long long i = 0; i < codeSize; ++i) {
+        Bytecode::op op{};
+        op.type = static_cast<InstructionType>(readNumber(InstructionType::NONE, InstructionType::DECJNE));
+        op.dst.isRegister = readNumber(0, 1) != 0;
+        op.dst.value = static_cast<int>(readNumber(intMin, intMax));
+        op.src.isRegister = readNumber(0, 1) != 0;
+        op.src.value = static_cast<int>(readNumber(intMin, intMax));
+        op.extra.isRegister = readNumber(0, 1) != 0;
+        op.extra.value = static_cast<int>(readNumber(intMin, intMax));
+        op.target = static_cast<int>(readNumber(-1, intMax));
+        op.fault = static_cast<int>(readNumber(-1, static_cast<long long>(bytecode.faults.size()) - 1));
+
+        if ((op.dst.isRegister && (op.dst.value < 0 || op.dst.value >= registerCount)) ||
+            (op.src.isRegister && (op.src.value < 0 || op.src.value >= registerCount)) ||
+            (op.extra.isRegister && (op.extra.value < 0 || op.extra.value >= registerCount))) {
+            throw invalid("register slot");
+        }
+        bool isJump = (op.type >= InstructionType::JMP && op.type <= InstructionType::CALL && op.type != InstructionType::CMP) ||
+            (op.type >= InstructionType::LOOP && op.type <= InstructionType::JZ) || op.type == InstructionType::SPAWN || op.type == InstructionType::DECJNE;
+        // ops which read or change a register must name one
+        bool isRegisterFirst = (op.type >= InstructionType::MOV && op.type <= InstructionType::DIV) || (op.type >= InstructionType::AND && op.type <= InstructionType::LOAD) ||
+            (op.type >= InstructionType::VHSUM && op.type <= InstructionType::VHMAX) || (op.type >= InstructionType::SYSCALL && op.type <= InstructionType::JOIN) ||
+            op.type == InstructionType::RECV || op.type == InstructionType::DECJNE;
+        if (!op.dst.isRegister && isRegisterFirst) throw invalid("destination register");
+        // ops which use vector registers must name existing ones
+        if (op.type >= InstructionType::VMOV && op.type <= InstructionType::VSTORE) {
+            auto isVector = [](const Bytecode::operand& operand) -> bool {
+                return !operand.isRegister && operand.value >= 0 && operand.value < Bytecode::vectorRegisters;
+            };
+            bool isValid = false;
+            if (op.type == InstructionType::VSET || op.type == InstructionType::VLOAD) isValid = isVector(op.dst);
+            else if (op.type == InstructionType::VSTORE || op.type >= InstructionType::VHSUM) isValid = isVector(op.src);
+            else isValid = isVector(op.dst) && isVector(op.src);
+            if (!isValid) throw invalid("vector register");
+        }
+        if (op.type == InstructionType::MSG) {
+            if (op.target < 0 || op.target >= static_cast<int>(bytecode.messages.size())) throw invalid("message index");
+        } else if (op.type == InstructionType::JTAB) {
+            if (op.target < 0 || op.target >= static_cast<int>(bytecode.tables.size())) throw invalid("jump table index");
+        } else if (op.type == InstructionType::PUSH || op.type == InstructionType::POP) {
+            if (op.target < 0 || op.target >= static_cast<int>(bytecode.stackOperands.size())) throw invalid("stack operands index");
+            if (op.type == InstructionType::POP) {
+                for (const Bytecode::operand& operand : bytecode.stackOperands[op.target]) {
+                    if (!operand.isRegister) throw invalid("stack operands");
+                }
+            }
+        } else if (op.type == InstructionType::SYSCALL) {
+            if (op.target < 0 || op.target >= static_cast<int>(bytecode.nativeCalls.size())) throw invalid("native call index");
+        } else if (op.target > codeSize) {
+            throw invalid("jump target");
+        } else if (op.target < 0 && op.fault < 0 && (op.type == InstructionType::NONE || isJump)) {
+            throw invalid("unresolved jump without fault");
+        }
+        // a fused op skips the ops it replaces
+        if (op.type == InstructionType::DECJNE && (i + 2 >= codeSize || op.target < 0)) throw invalid("fused op");
+        if (op.type >= InstructionType::CMOVNE && op.type <= InstructionType::CMOVL && op.target >= 0 && op.target != i + 2 && op.target != i + 4) {
+            throw invalid("fused op");
+        }
+        bytecode.code.push_back(op);
+    }
+    // a fused op reads the ops it replaces, so they must have the shape Bytecode::optimize() leaves behind
+    const std::vector<Bytecode::op>& code = bytecode.code;
+    auto isSame = [](const Bytecode::operand& a, const Bytecode::operand& b) -> bool {
+        return a.isRegister == b.isRegister && a.value == b.value;
+    };
+    for (size_t i = 0; i < code.size(); ++i) {
+        const Bytecode::op& op = code[i];
+        if (op.type == InstructionType::DECJNE) {
+            const Bytecode::op& cmp = code[i + 1];
+            const Bytecode::op& jne = code[i + 2];
+            // the JNE may itself have become a CMOVNE, whose target is after the "else" MOV of an if ... else
+            bool isJne = jne.type == InstructionType::JNE && jne.target == op.target;
+            bool isMove = jne.type == InstructionType::CMOVNE && jne.target >= 0 &&
+                (static_cast<size_t>(jne.target) == i + 4 ? jne.target : jne.target - 1) == op.target;
+            if (cmp.type != InstructionType::CMP || !isSame(cmp.dst, op.dst) || !isSame(cmp.src, op.src) || !(isJne || isMove)) {
+                throw invalid("fused op");
+            }
+            continue;
+        }
+        if (op.type < InstructionType::CMOVNE || op.type > InstructionType::CMOVL || op.target < 0) continue;
+        auto isMoveTo = [&](size_t position) -> bool {
+            return position < code.size() && code[position].type == InstructionType::MOV && isSame(code[position].dst, op.dst);
+        };
+        bool isValid = isMoveTo(i + 1);
+        if (static_cast<size_t>(op.target) == i + 2) {
+            isValid = isValid && isSame(op.src, op.dst);
+        } else {
+            isValid = isValid && code[i + 2].type == InstructionType::JMP && static_cast<size_t>(code[i + 2].target) == i + 4 &&
+                isMoveTo(i + 3) && isSame(code[i + 3].src, op.src);
+        }
+        if (!isValid) throw invalid("fused op");
+    }
+
+    for (const std::vector<int>& table : bytecode.tables) {
+        for (int position : table) {
+            if (static_cast<size_t>(position) > bytecode.code.size()) throw invalid("jump table position");
+        }
+    }
+    for (const auto& label : labels) {
+        if (label.second > bytecode.code.size()) throw invalid("label position");
+        bytecode.labels[label.first] = label.second;
+    }
+
+    return bytecode;
+}
+
+// bytecode engine
+void fillInts(int* destination, size_t count, int value)
+{
+    // This function sets `count` ints to the value, four at once where SSE2 is available.
+    // memset() only fills bytes. GCC 12 vectorizes the plain loop at -O3, but at -O2 its "very cheap" cost model keeps it scalar
+    // because `count` is not a known multiple of four; there the SSE2 loop fills 256 or 4096 ints about 4 times faster.
+
+    size_t i = 0;
+#ifdef __SSE2__
+    __m128i values = _mm_set1_epi32(value);
+    for (; i + 4 <= count; i += 4) _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + i), values);
+#endif
+    for (; i < count; ++i) destination[i] = value;
+}
+
+void applyLanes(InstructionType type, int* destination, const int* source)
+{
+    // This function runs a lane-wise vector instruction (VMOV ... VCMPGT) on the lanes of two vector registers.
+    // It uses one AVX2 or two SSE4.1 instructions where the target supports them and a loop elsewhere.
+    // Lanes wrap around on overflow in all cases.
+
+#if defined(__AVX2__)
+    __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(destination));
+    __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source));
+    switch (type)
+    {
+    case InstructionType::VADD: a = _mm256_add_epi32(a, b); break;
+    case InstructionType::VSUB: a = _mm256_sub_epi32(a, b); break;
+    case InstructionType::VMUL: a = _mm256_mullo_epi32(a, b); break;
+    case InstructionType::VMIN: a = _mm256_min_epi32(a, b); break;
+    case InstructionType::VMAX: a = _mm256_max_epi32(a, b); break;
+    case InstructionType::VCMPEQ: a = _mm256_cmpeq_epi32(a, b); break;
+    case InstructionType::VCMPGT: a = _mm256_cmpgt_epi32(a, b); break;
+    default: a = b; break;
+    }
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(destination), a);
+#elif defined(__SSE4_1__)
+    for (size_t half = 0; half < Bytecode::vectorLanes; half += 4) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(destination + half));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + half));
+        switch (type)
+        {
+        case InstructionType::VADD: a = _mm_add_epi32(a, b); break;
+        case InstructionType::VSUB: a = _mm_sub_epi32(a, b); break;
+        case InstructionType::VMUL: a = _mm_mullo_epi32(a, b); break;
+        case InstructionType::VMIN: a = _mm_min_epi32(a, b); break;
+        case InstructionType::VMAX: a = _mm_max_epi32(a, b); break;
+        case InstructionType::VCMPEQ: a = _mm_cmpeq_epi32(a, b); break;
+        case InstructionType::VCMPGT: a = _mm_cmpgt_epi32(a, b); break;
+        default: a = b; break;
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + half), a);
+    }
+#else
+    // one loop per instruction, so the compiler can vectorize each of them
+    auto lanes = [&](auto operation) -> void {
+        for (size_t i = 0; i < Bytecode::vectorLanes; ++i) {
+            destination[i] = static_cast<int>(operation(static_cast<uint32_t>(destination[i]), static_cast<uint32_t>(source[i])));
+        }
+    };
+    switch (type)
+    {
+    case InstructionType::VADD: lanes([](uint32_t a, uint32_t b) { return a + b; }); break;
+    case InstructionType::VSUB: lanes([](uint32_t a, uint32_t b) { return a - b; }); break;
+    case InstructionType::VMUL: lanes([](uint32_t a, uint32_t b) { return a * b; }); break;
+    case InstructionType::VMIN: lanes([](uint32_t a, uint32_t b) { return static_cast<int>(a) < static_cast<int>(b) ? a : b; }); break;
+    case InstructionType::VMAX: lanes([](uint32_t a, uint32_t b) { return static_cast<int>(a) > static_cast<int>(b) ? a : b; }); break;
+    case InstructionType::VCMPEQ: lanes([](uint32_t a, uint32_t b) { return a == b ? UINT32_MAX : 0u; }); break;
+    case InstructionType::VCMPGT: lanes([](uint32_t a, uint32_t b) { return static_cast<int>(a) > static_cast<int>(b) ? UINT32_MAX : 0u; }); break;
+    default: lanes([](uint32_t, uint32_t b) { return b; }); break;
+    }
+#endif
+}
+
+BytecodeEngine::BytecodeEngine(std::shared_ptr<const Bytecode> bytecode)
+    : bytecode(bytecode)
+{
+    this->regs = std::vector<int>(this->bytecode->registerNames.size(), 0);
+    bool isVectorUsed = std::any_of(this->bytecode->code.begin(), this->bytecode->code.end(), [](const Bytecode::op& op) {
+        return op.type >= InstructionType::VMOV && op.type <= InstructionType::VSTORE;
+    });
+    this->vectors = std::vector<int>(isVectorUsed ? Bytecode::vectorRegisters * Bytecode::vectorLanes : 0, 0);
+    this->callStack = {};
+    this->cmpResult = 0;
+    this->message = -1;
+    this->executedInstructions = 0;
+    this->instructionLimit = UINT64_MAX;
+    this->recorder = nullptr;
+    this->output = "-1";
+    this->isTaskUsed = std::any_of(this->bytecode->code.begin(), this->bytecode->code.end(), [](const Bytecode::op& op) {
+        return op.type >= InstructionType::SPAWN && op.type <= InstructionType::RECV;
+    });
+    this->tasks = nullptr;
+    this->taskId = 0;
+    this->instructionPointer = 0;
+}
+
+BytecodeEngine::BytecodeEngine(const BytecodeEngine& parent, int taskId, size_t position)
+    : bytecode(parent.bytecode)
+{
+    this->regs = parent.regs;
+    this->memory = parent.memory;
+    this->dataStack = {};
+    this->vectors = std::vector<int>(parent.vectors.size(), 0);
+    this->callStack = {};
+    this->cmpResult = 0;
+    this->message = -1;
+    this->executedInstructions = 0;
+    this->instructionLimit = parent.instructionLimit;
+    this->recorder = nullptr;
+    this->output = "-1";
+    this->isTaskUsed = true;
+    this->tasks = parent.tasks;
+    this->taskId = taskId;
+    this->instructionPointer = position;
+}
+
+void BytecodeEngine::setInstructionLimit(uint64_t limit)
+{
+    this->instructionLimit = limit;
+}
+
+uint64_t BytecodeEngine::getExecutedInstructions() const
+{
+    return this->executedInstructions;
+}
+
+void BytecodeEngine::setRecorder(TraceRecorder* recorder)
+{
+    this->recorder = recorder;
+}
+
+void BytecodeEngine::reset()
+{
+    std::fill(this->regs.begin(), this->regs.end(), 0);
+}
+
+void BytecodeEngine::setRegister(int slot, int value)
+{
+    this->regs[slot] = value;
+}
+
+int BytecodeEngine::getRegister(int slot) const
+{
+    return this->regs[slot];
+}
+
+void BytecodeEngine::run(bool renderMessage)
+{
+    if (!isMetricsEnabled.load(std::memory_order_relaxed)) {
+        this->execute(renderMessage);
+        return;
+    }
+
+    LatencyTimer timer(metrics.executeLatency);
+    try {
+        this->execute(renderMessage);
+    } catch (const std::string& e) {
+        metrics.recordFault(e);
+        throw;
+    }
+    metrics.instructionsPerRun.record(this->executedInstructions);
+}
+
+void BytecodeEngine::execute(bool renderMessage)
+{
+    TraceSpan span("execute");
+
+    this->callStack.clear();
+    this->cmpResult = 0;
+    this->message = -1;
+    this->executedInstructions = 0;
+    this->output = "-1";
+    this->memory = this->bytecode->memory;
+    this->dataStack.clear();
+    std::fill(this->vectors.begin(), this->vectors.end(), 0);
+    this->instructionPointer = 0;
+
+    // the position is published only when the control flow changes, so straight-line code does not pay for profiling
+    // and a sample is attributed to the place where the current sequence of instructions started
+    ProbeScope probeScope{};
+
+    if (!this->isTaskUsed) {
+        this->resume(renderMessage, this->instructionLimit, probeScope.get());
+        return;
+    }
+
+    this->tasks = std::make_shared<TaskGroup>(*this->bytecode, this->instructionLimit);
+    try {
+        this->resume(renderMessage, this->instructionLimit, probeScope.get());
+        // the run ends once every task has finished
+        this->tasks->finish();
+    } catch (const std::string&) {
+        this->tasks->cancel();
+        throw;
+    }
+    this->executedInstructions += this->tasks->getExecutedInstructions();
+}
+
+BytecodeEngine::state BytecodeEngine::resume(bool renderMessage, uint64_t stopAt, ExecutionProbe* probe)
+{
+    // This function is the equivalent of `Interpreter::execute()` for compiled programs.
+    // Every op behaves exactly as the corresponding instruction in `execute()`, including errors.
+    // Only the program publishes its position and records its control flow and calls, spawned tasks do not.
+
+    const std::vector<Bytecode::op>& code = this->bytecode->code;
+    size_t instructionPointer = this->instructionPointer;
+
+    auto value = [&](const Bytecode::operand& operand) -> int {
+        return operand.isRegister ? this->regs[operand.value] : operand.value;
+    };
+    auto checkMemory = [&](long long address, long long count) -> size_t {
+        if (count < 0) throw "ERROR::INTERPRETER::INVALID_COUNT: " + std::to_string(count);
+        if (address < 0 || address + count > static_cast<long long>(this->memory.size())) {
+            throw "ERROR::INTERPRETER::MEMORY_OUT_OF_BOUNDS: " + std::to_string(address);
+        }
+        return static_cast<size_t>(address);
+    };
+    // returns the first lane of a vector register
+    auto lanesOf = [&](const Bytecode::operand& operand) -> int* {
+        return this->vectors.data() + static_cast<size_t>(operand.value) * Bytecode::vectorLanes;
+    };
+    if (probe) probe->enter(instructionPointer);
+    // the op runs again once the spawned task is resumed
+    auto suspend = [&](BytecodeEngine::state state) -> BytecodeEngine::state {
+        this->instructionPointer = instructionPointer - 1;
+        this->executedInstructions--;
+        return state;
+    };
+
+    auto jump = [&](const Bytecode::op& op) -> void {
+        if (op.target < 0) throw this->bytecode->faults[op.fault];
+        instructionPointer = static_cast<size_t>(op.target);
+        if (probe) probe->enter(instructionPointer);
+    };
+    TraceRecorder* recorder = this->recorder;
+    auto branch = [&](const Bytecode::op& op, bool isTaken) -> void {
+        if (recorder) recorder->branch(isTaken);
+        if (isTaken) jump(op);
+    };
+    auto conditionalMove = [&](const Bytecode::op& op, bool isMoved) -> void {
+        if (op.target < 0) {
+            this->regs[op.dst.value] = isMoved ? value(op.src) : this->regs[op.dst.value];
+            return;
+        }
+        // a jump over MOVs converted by Bytecode::optimize(), the condition is the one of the jump
+        // the path of a jump over "mov" has 0 or 1 more instructions, over "mov / jmp" to "mov" 1 or 2
+        const Bytecode::op& then = code[instructionPointer];
+        uint64_t skipped = (static_cast<size_t>(op.target) - instructionPointer + 1) / 2 - (isMoved ? 1 : 0);
+        if (stopAt - this->executedInstructions < skipped) {
+            // the slice ends or the limit is reached inside the fused ops, so the replaced jump is taken and the MOVs are run one by one
+            Bytecode::op replaced = op;
+            if (static_cast<size_t>(op.target) == instructionPointer + 3) --replaced.target;
+            branch(replaced, isMoved);
+            return;
+        }
+        this->executedInstructions += skipped;
+        this->regs[op.dst.value] = isMoved ? value(op.src) : value(then.src);
+        if (recorder) recorder->branch(isMoved);
+        jump(op);
+    };
+
+    TraceBuffer* trace = this->taskId == 0 && isTracingEnabled.load(std::memory_order_relaxed) ? TraceBuffer::current() : nullptr;
+    uint32_t traceProgram = trace ? trace->addProgram(this->bytecode) : 0;
+    // calls which are still active when the run finishes end with it
+    struct openCalls {
+        TraceBuffer* trace;
+        const std::vector<size_t>& callStack;
+        const uint64_t& instructions;
+        ~openCalls() {
+            if (this->trace) for (size_t depth = this->callStack.size(); depth > 0; --depth) this->trace->endCall(depth - 1, this->instructions);
+        }
+    } openCallsGuard{trace, this->callStack, this->executedInstructions};
+
+    while (instructionPointer < code.size()) {
+        const Bytecode::op& op = code[instructionPointer++];
+        if (++this->executedInstructions > stopAt) {
+            if (this->executedInstructions > this->instructionLimit) throw "ERROR::INTERPRETER::INSTRUCTION_LIMIT_EXCEEDED: " + std::to_string(this->instructionLimit);
+            return suspend(BytecodeEngine::PREEMPTED);
+        }
+
+        switch (op.type)
+        {
+        case InstructionType::MOV:
+            this->regs[op.dst.value] = value(op.src);
+            break;
+        case InstructionType::INC:
+            this->regs[op.dst.value] = wrapAdd(this->regs[op.dst.value], 1);
+            break;
+        case InstructionType::DEC:
+            this->regs[op.dst.value] = wrapSub(this->regs[op.dst.value], 1);
+            break;
+        case InstructionType::ADD:
+            this->regs[op.dst.value] = wrapAdd(this->regs[op.dst.value], value(op.src));
+            break;
+        case InstructionType::SUB:
+            this->regs[op.dst.value] = wrapSub(this->regs[op.dst.value], value(op.src));
+            break;
+        case InstructionType::MUL:
+            this->regs[op.dst.value] = wrapMul(this->regs[op.dst.value], value(op.src));
+            break;
+        case InstructionType::DIV: {
+            int divisor = value(op.src);
+            if (divisor == 0) throw std::string("ERROR::INTERPRETER::DIVISION_BY_ZERO");
+            int& dividend = this->regs[op.dst.value];
+            dividend = divisor == -1 ? static_cast<int>(0u - static_cast<unsigned>(dividend)) : dividend / divisor;
+            break;
+        }
+        case InstructionType::AND:
+            this->regs[op.dst.value] &= value(op.src);
+            break;
+        case InstructionType::OR:
+            this->regs[op.dst.value] |= value(op.src);
+            break;
+        case InstructionType::XOR:
+            this->regs[op.dst.value] ^= value(op.src);
+            break;
+        case InstructionType::NOT:
+            this->regs[op.dst.value] = ~this->regs[op.dst.value];
+            break;
+        case InstructionType::SHL:
+            this->regs[op.dst.value] = static_cast<int>(static_cast<uint32_t>(this->regs[op.dst.value]) << (value(op.src) & 31));
+            break;
+        case InstructionType::SHR:
+            this->regs[op.dst.value] = static_cast<int>(static_cast<uint32_t>(this->regs[op.dst.value]) >> (value(op.src) & 31));
+            break;
+        case InstructionType::MOD: {
+            int divisor = value(op.src);
+            if (divisor == 0) throw std::string("ERROR::INTERPRETER::DIVISION_BY_ZERO");
+            this->regs[op.dst.value] = divisor == -1 ? 0 : this->regs[op.dst.value] % divisor;
+            break;
+        }
+        case InstructionType::LOOP:
+            this->cmpResult = this->regs[op.dst.value] = wrapSub(this->regs[op.dst.value], 1);
+            branch(op, this->cmpResult != 0);
+            break;
+        case InstructionType::JNZ:
+            this->cmpResult = this->regs[op.dst.value];
+            branch(op, this->cmpResult != 0);
+            break;
+        case InstructionType::JZ:
+            this->cmpResult = this->regs[op.dst.value];
+            branch(op, this->cmpResult == 0);
+            break;
+        case InstructionType::DECJNE:
+            this->regs[op.dst.value] = wrapSub(this->regs[op.dst.value], 1);
+            // if the slice ends or the limit is reached inside the fused ops, the CMP and JNE after this op are run one by one to stop at the same op
+            if (stopAt - this->executedInstructions < 2) break;
+            this->executedInstructions += 2;
+            this->cmpResult = compareValues(this->regs[op.dst.value], value(op.src));
+            branch(op, this->cmpResult != 0);
+            if (this->cmpResult == 0) instructionPointer += 2;
+            break;
+        case InstructionType::CMOVNE:
+            conditionalMove(op, this->cmpResult != 0);
+            break;
+        case InstructionType::CMOVE:
+            conditionalMove(op, this->cmpResult == 0);
+            break;
+        case InstructionType::CMOVGE:
+            conditionalMove(op, this->cmpResult >= 0);
+            break;
+        case InstructionType::CMOVG:
+            conditionalMove(op, this->cmpResult > 0);
+            break;
+        case InstructionType::CMOVLE:
+            conditionalMove(op, this->cmpResult <= 0);
+            break;
+        case InstructionType::CMOVL:
+            conditionalMove(op, this->cmpResult < 0);
+            break;
+        case InstructionType::LOAD:
+            this->regs[op.dst.value] = this->memory[checkMemory(static_cast<long long>(value(op.src)) + value(op.extra), 1)];
+            break;
+        case InstructionType::STORE:
+            this->memory[checkMemory(static_cast<long long>(value(op.dst)) + value(op.extra), 1)] = value(op.src);
+            break;
+        case InstructionType::MEMSET: {
+            long long count = value(op.extra);
+            size_t address = checkMemory(value(op.dst), count);
+            fillInts(this->memory.data() + address, static_cast<size_t>(count), value(op.src));
+            break;
+        }
+        case InstructionType::MEMCPY: {
+            long long count = value(op.extra);
+            size_t destination = checkMemory(value(op.dst), count);
+            size_t source = checkMemory(value(op.src), count);
+            // memmove() of the C library is vectorized and handles overlapping ranges
+            if (count > 0) std::memmove(this->memory.data() + destination, this->memory.data() + source, static_cast<size_t>(count) * sizeof(int));
+            break;
+        }
+        case InstructionType::VMOV:
+        case InstructionType::VADD:
+        case InstructionType::VSUB:
+        case InstructionType::VMUL:
+        case InstructionType::VMIN:
+        case InstructionType::VMAX:
+        case InstructionType::VCMPEQ:
+        case InstructionType::VCMPGT:
+            applyLanes(op.type, lanesOf(op.dst), lanesOf(op.src));
+            break;
+        case InstructionType::VSET:
+            std::fill_n(lanesOf(op.dst), Bytecode::vectorLanes, value(op.src));
+            break;
+        case InstructionType::VHSUM: {
+            const int* source = lanesOf(op.src);
+            uint32_t sum = 0;
+            for (size_t i = 0; i < Bytecode::vectorLanes; ++i) sum += static_cast<uint32_t>(source[i]);
+            this->regs[op.dst.value] = static_cast<int>(sum);
+            break;
+        }
+        case InstructionType::VHMIN:
+            this->regs[op.dst.value] = *std::min_element(lanesOf(op.src), lanesOf(op.src) + Bytecode::vectorLanes);
+            break;
+        case InstructionType::VHMAX:
+            this->regs[op.dst.value] = *std::max_element(lanesOf(op.src), lanesOf(op.src) + Bytecode::vectorLanes);
+            break;
+        case InstructionType::VLOAD: {
+            size_t address = checkMemory(static_cast<long long>(value(op.src)) + value(op.extra), Bytecode::vectorLanes);
+            std::memcpy(lanesOf(op.dst), this->memory.data() + address, Bytecode::vectorLanes * sizeof(int));
+            break;
+        }
+        case InstructionType::VSTORE: {
+            size_t address = checkMemory(static_cast<long long>(value(op.dst)) + value(op.extra), Bytecode::vectorLanes);
+            std::memcpy(this->memory.data() + address, lanesOf(op.src), Bytecode::vectorLanes * sizeof(int));
+            break;
+        }
+        case InstructionType::PUSH: {
+            const std::vector<Bytecode::operand>& operands = this->bytecode->stackOperands[op.target];
+            if (this->dataStack.size() + operands.size() > Bytecode::maxStackSize) throw std::string("ERROR::INTERPRETER::STACK_OVERFLOW");
+            for (const Bytecode::operand& operand : operands) this->dataStack.push_back(value(operand));
+            break;
+        }
+        case InstructionType::POP: {
+            const std::vector<Bytecode::operand>& operands = this->bytecode->stackOperands[op.target];
+            if (this->dataStack.size() < operands.size()) throw std::string("ERROR::INTERPRETER::STACK_UNDERFLOW");
+            for (size_t i = operands.size(); i > 0; --i) {
+                this->regs[operands[i - 1].value] = this->dataStack.back();
+                this->dataStack.pop_back();
+            }
+            break;
+        }
+        case InstructionType::SYSCALL: {
+            const Bytecode::nativeCall& call = this->bytecode->nativeCalls[op.target];
+            int args[NativeFunctions::maxArguments];
+            for (size_t i = 0; i < call.args.size(); ++i) args[i] = value(call.args[i]);
+            this->regs[op.dst.value] = call.function(args, call.args.size());
+            break;
+        }
+        case InstructionType::SPAWN:
+            if (op.target < 0) throw this->bytecode->faults[op.fault];
+            this->tasks->spawn(*this, op.dst.value, static_cast<size_t>(op.target));
+            break;
+        case InstructionType::JOIN:
+            if (!this->tasks->join(*this, this->regs[op.dst.value])) return suspend(BytecodeEngine::BLOCKED);
+            break;
+        case InstructionType::SEND:
+            if (!this->tasks->send(*this, value(op.dst), value(op.src))) return suspend(BytecodeEngine::BLOCKED);
+            break;
+        case InstructionType::RECV:
+            if (!this->tasks->receive(*this, value(op.src), this->regs[op.dst.value])) return suspend(BytecodeEngine::BLOCKED);
+            break;
+        case InstructionType::JTAB: {
+            const std::vector<int>& table = this->bytecode->tables[op.target];
+            int index = this->regs[op.dst.value];
+            if (index >= 0 && static_cast<size_t>(index) < table.size()) {
+                instructionPointer = static_cast<size_t>(table[index]);
+                if (probe) probe->enter(instructionPointer);
+            }
+            if (recorder) recorder->target(instructionPointer);
+            break;
+        }
+        case InstructionType::JMP:
+            jump(op);
+            break;
+        case InstructionType::CMP:
+            this->cmpResult = compareValues(value(op.dst), value(op.src));
+            break;
+        case InstructionType::JNE:
+            branch(op, this->cmpResult != 0);
+            break;
+        case InstructionType::JE:
+            branch(op, this->cmpResult == 0);
+            break;
+        case InstructionType::JGE:
+            branch(op, this->cmpResult >= 0);
+            break;
+        case InstructionType::JG:
+            branch(op, this->cmpResult > 0);
+            break;
+        case InstructionType::JLE:
+            branch(op, this->cmpResult <= 0);
+            break;
+        case InstructionType::JL:
+            branch(op, this->cmpResult < 0);
+            break;
+        case InstructionType::CALL:
+            if (this->callStack.size() >= Bytecode::maxCallDepth) throw std::string("ERROR::INTERPRETER::CALL_STACK_OVERFLOW");
+            this->callStack.push_back(instructionPointer);
+            jump(op);
+            if (probe) probe->call(instructionPointer, this->callStack.size());
+            if (trace) trace->beginCall(traceProgram, instructionPointer, this->callStack.size() - 1, this->executedInstructions);
+            break;
+        case InstructionType::MSG:
+            this->message = op.target;
+            break;
+        case InstructionType::RET:
+            if (this->callStack.empty()) throw std::string("ERROR::INTERPRETER::RET_WITHOUT_CALL");
+            instructionPointer = this->callStack.back();
+            this->callStack.pop_back();
+            if (recorder) recorder->target(instructionPointer);
+            if (trace) trace->endCall(this->callStack.size(), this->executedInstructions);
+            if (probe) {
+                probe->ret(this->callStack.size());
+                probe->enter(instructionPointer);
+            }
+            break;
+        case InstructionType::END:
+            if (renderMessage) this->createMessage();
+            return BytecodeEngine::FINISHED;
+        case InstructionType::NONE:
+            if (op.fault >= 0) throw this->bytecode->faults[op.fault];
+            break;
+        default:
+            break;
+        }
+    }
+    return BytecodeEngine::FINISHED;
+}
+
+void BytecodeEngine::createMessage()
+{
+    TraceSpan span("render message");
+
+    if (this->message < 0 || this->bytecode->messages[this->message].empty()) {
+        // default output
+        this->output = "-1";
+        return;
+    }
+
+    this->output.clear();
+    for (const Bytecode::messagePart& part : this->bytecode->messages[this->message]) {
+        switch (part.kind)
+        {
+        case Bytecode::messagePart::TEXT:
+            this->output += part.text;
+            break;
+        case Bytecode::messagePart::REGISTER:
+            this->output += std::to_string(this->regs[part.slot]);
+            break;
+        default:
+            throw "ERROR::INTERPRETER::INVALID_MSG_ARGUMENT: " + part.text;
+        }
+    }
+}
+
+const std::string& BytecodeEngine::getOutput() const
+{
+    return this->output;
+}
+
+std::string assembler_interpreter(std::string program) {
+    Interpreter interpreter(program);
+    return interpreter.getOutput();
+}
+
+// helpers
+std::string readFile(const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file) throw "ERROR::FILE::CAN_NOT_OPEN: " + path;
+    std::stringstream content;
+    content << file.rdbuf();
+    return content.str();
+}
+
+std::vector<std::pair<std::string, int>> parseRegisterValues(const std::string& line)
+{
+    // This function parses a list of initial register values written as "name=value" pairs separated by whitespaces, e.g. "a=5 b=-3".
+    // Everything after ';' is treated as a comment.
+
+    std::stringstream ss(line.substr(0, line.find(';')));
+    std::vector<std::pair<std::string, int>> values{};
+    std::string token = "";
+
+    while (ss >> token) {
+        size_t pos = token.find('=');
+        if (pos == std::string::npos || pos == 0) throw "ERROR::INPUT::INVALID_REGISTER_VALUE: " + token;
+        try {
+            size_t length = 0;
+            int value = std::stoi(token.substr(pos + 1), &length);
+            if (length != token.length() - pos - 1) throw std::invalid_argument(token);
+            values.push_back({token.substr(0, pos), value});
+        } catch (const std::logic_error&) {
+            throw "ERROR::INPUT::INVALID_REGISTER_VALUE: " + token;
+        }
+    }
+    return values;
+}
+
+std::vector<std::vector<std::pair<std::string, int>>> parseJobs(const std::string& content)
+{
+    // one job per line, lines which are empty or contain only comments are skipped
+    std::stringstream ss(content);
+    std::vector<std::vector<std::pair<std::string, int>>> jobs{};
+    std::string line = "";
+
+    while (std::getline(ss, line)) {
+        if (line.substr(0, line.find(';')).find_first_not_of(" \t\r") == std::string::npos) continue;
+        jobs.push_back(parseRegisterValues(line));
+    }
+    return jobs;
+}
+
+// runs submitted tasks on a fixed number of threads
+class WorkerPool
+{
+private:
+    std::vector<std::thread> threads;
+    std::deque<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable condition;
+    bool isStopping;
+
+    void runThread();
+public:
+    explicit WorkerPool(size_t threadCount);
+    // finishes all submitted tasks before returning
+    ~WorkerPool();
+
+    void submit(std::function<void()> task);
+    // number of tasks waiting for a free thread
+    size_t getQueueDepth();
+};
+
+WorkerPool::WorkerPool(size_t threadCount)
+{
+    this->tasks = {};
+    this->isStopping = false;
+    for (size_t i = 0; i < std::max<size_t>(threadCount, 1); ++i) this->threads.emplace_back(&WorkerPool::runThread, this);
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->isStopping = true;
+    }
+    this->condition.notify_all();
+    for (std::thread& t : this->threads) t.join();
+}
+
+void WorkerPool::runThread()
+{
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            this->condition.wait(lock, [&]() { return this->isStopping || !this->tasks.empty(); });
+            if (this->tasks.empty()) return;
+            task = std::move(this->tasks.front());
+            this->tasks.pop_front();
+            if (isMetricsEnabled.load(std::memory_order_relaxed)) metrics.queueDepth--;
+        }
+        task();
+    }
+}
+
+void WorkerPool::submit(std::function<void()> task)
+{
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->tasks.push_back(std::move(task));
+        if (isMetricsEnabled.load(std::memory_order_relaxed)) metrics.queueDepth++;
+    }
+    this->condition.notify_one();
+}
+
+size_t WorkerPool::getQueueDepth()
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    return this->tasks.size();
+}
+
+// tasks
+TaskGroup::TaskGroup(const Bytecode& bytecode, uint64_t instructionLimit)
+{
+    this->isProgramWaiting = false;
+    for (int capacity : bytecode.channels) this->channels.push_back({{}, static_cast<size_t>(capacity), {}});
+    this->ready = {};
+    this->running = 0;
+    this->unfinished = 0;
+    this->unjoined = 0;
+    this->instructionLimit = instructionLimit;
+    this->executedInstructions = 0;
+    this->isFailed = false;
+    this->error = "";
+}
+
+WorkerPool& TaskGroup::pool()
+{
+    // shared by all runs, created by the first SPAWN
+    static WorkerPool workers(std::max(1u, std::thread::hardware_concurrency()));
+    return workers;
+}
+
+void TaskGroup::schedule(int id)
+{
+    this->tasks[id - 1].state = TaskGroup::READY;
+    this->ready.push_back(id);
+    std::shared_ptr<TaskGroup> group = this->shared_from_this();
+    TaskGroup::pool().submit([group]() {
+        std::unique_lock<std::mutex> lock(group->mutex);
+        // the task may have been run by the program in the meantime
+        if (!group->isFailed && !group->ready.empty()) group->runSlice(lock);
+    });
+    this->notifyProgram();
+}
+
+void TaskGroup::wake(std::vector<int>& ids)
+{
+    for (int id : ids) {
+        TaskGroup::task& t = this->tasks[id - 1];
+        if (t.state == TaskGroup::BLOCKED) this->schedule(id);
+        else if (t.state == TaskGroup::RUNNING) t.isWoken = true;
+    }
+    ids.clear();
+    this->notifyProgram();
+}
+
+void TaskGroup::fail(const std::string& error)
+{
+    if (!this->isFailed) {
+        this->isFailed = true;
+        this->error = error;
+    }
+    this->ready.clear();
+    this->notifyProgram();
+}
+
+void TaskGroup::notifyProgram()
+{
+    if (this->isProgramWaiting) this->condition.notify_one();
+}
+
+TaskGroup::channel& TaskGroup::findChannel(int index)
+{
+    if (index < 0 || index >= static_cast<int>(this->channels.size())) throw "ERROR::INTERPRETER::INVALID_CHANNEL: " + std::to_string(index);
+    return this->channels[static_cast<size_t>(index)];
+}
+
+void TaskGroup::runSlice(std::unique_lock<std::mutex>& lock)
+{
+    int id = this->ready.front();
+    this->ready.pop_front();
+    this->tasks[id - 1].state = TaskGroup::RUNNING;
+    this->tasks[id - 1].isWoken = false;
+    BytecodeEngine* engine = this->tasks[id - 1].engine.get();
+    this->running++;
+    lock.unlock();
+
+    BytecodeEngine::state state = BytecodeEngine::FINISHED;
+    bool isFailed = false;
+    std::string error = "";
+    while (true) {
+        try {
+            state = engine->resume(false, std::min(this->instructionLimit, engine->executedInstructions + TaskGroup::sliceInstructions), nullptr);
+        } catch (const std::string& e) {
+            isFailed = true;
+            error = e;
+        }
+        lock.lock();
+        // a task keeps its thread while no other task is ready
+        if (isFailed || this->isFailed || state != BytecodeEngine::PREEMPTED || !this->ready.empty()) break;
+        lock.unlock();
+    }
+
+    this->running--;
+    TaskGroup::task& t = this->tasks[id - 1];
+    if (isFailed) {
+        this->fail(error);
+    } else if (this->isFailed) {
+        // the run has already failed, the task is not continued
+    } else if (state == BytecodeEngine::FINISHED) {
+        t.state = TaskGroup::FINISHED;
+        this->unfinished--;
+        this->executedInstructions += engine->executedInstructions;
+        t.engine = nullptr;
+        this->wake(t.joiners);
+    } else if (state == BytecodeEngine::PREEMPTED || t.isWoken) {
+        this->schedule(id);
+    } else {
+        t.state = TaskGroup::BLOCKED;
+    }
+    this->notifyProgram();
+}
+
+void TaskGroup::waitForChange(std::unique_lock<std::mutex>& lock)
+{
+    if (this->isFailed) throw this->error;
+    if (!this->ready.empty()) {
+        this->runSlice(lock);
+        return;
+    }
+    // the program waits and so does every task
+    if (this->running == 0) throw std::string("ERROR::INTERPRETER::DEADLOCK");
+    this->isProgramWaiting = true;
+    this->condition.wait(lock);
+    this->isProgramWaiting = false;
+}
+
+void TaskGroup::spawn(BytecodeEngine& parent, int slot, size_t position)
+{
+    int id = 0;
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        if (this->unjoined >= Bytecode::maxTasks) throw std::string("ERROR::INTERPRETER::TOO_MANY_TASKS");
+        this->tasks.push_back({nullptr, TaskGroup::READY, false, false, {}});
+        id = static_cast<int>(this->tasks.size());
+        this->unfinished++;
+        this->unjoined++;
+    }
+    parent.regs[slot] = id;
+    // the memory is copied without holding the lock
+    std::unique_ptr<BytecodeEngine> engine(new BytecodeEngine(parent, id, position));
+
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->tasks[id - 1].engine = std::move(engine);
+    this->schedule(id);
+}
+
+bool TaskGroup::join(BytecodeEngine& task, int id)
+{
+    std::unique_lock<std::mutex> lock(this->mutex);
+    if (id < 1 || id > static_cast<int>(this->tasks.size())) throw "ERROR::INTERPRETER::INVALID_TASK: " + std::to_string(id);
+    while (this->tasks[id - 1].state != TaskGroup::FINISHED) {
+        if (task.taskId != 0) {
+            this->tasks[id - 1].joiners.push_back(task.taskId);
+            return false;
+        }
+        this->waitForChange(lock);
+    }
+    if (!this->tasks[id - 1].isJoined) {
+        this->tasks[id - 1].isJoined = true;
+        this->unjoined--;
+    }
+    return true;
+}
+
+bool TaskGroup::send(BytecodeEngine& task, int index, int value)
+{
+    std::unique_lock<std::mutex> lock(this->mutex);
+    TaskGroup::channel& c = this->findChannel(index);
+    while (c.values.size() >= c.capacity) {
+        if (task.taskId != 0) {
+            c.waiting.push_back(task.taskId);
+            return false;
+        }
+        this->waitForChange(lock);
+    }
+    c.values.push_back(value);
+    this->wake(c.waiting);
+    return true;
+}
+
+bool TaskGroup::receive(BytecodeEngine& task, int index, int& value)
+{
+    std::unique_lock<std::mutex> lock(this->mutex);
+    TaskGroup::channel& c = this->findChannel(index);
+    while (c.values.empty()) {
+        if (task.taskId != 0) {
+            c.waiting.push_back(task.taskId);
+            return false;
+        }
+        this->waitForChange(lock);
+    }
+    value = c.values.front();
+    c.values.pop_front();
+    this->wake(c.waiting);
+    return true;
+}
+
+void TaskGroup::finish()
+{
+    std::unique_lock<std::mutex> lock(this->mutex);
+    while (this->isFailed || this->unfinished > 0) this->waitForChange(lock);
+}
+
+void TaskGroup::cancel()
+{
+    std::unique_lock<std::mutex> lock(this->mutex);
+    this->fail("ERROR::INTERPRETER::CANCELLED");
+    while (this->running > 0) {
+        this->isProgramWaiting = true;
+        this->condition.wait(lock);
+        this->isProgramWaiting = false;
+    }
+    // engines of tasks refer to the group, releasing them frees the group with the last reference
+    for (TaskGroup::task& t : this->tasks) t.engine = nullptr;
+}
+
+uint64_t TaskGroup::getExecutedInstructions()
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    return this->executedInstructions;
+}
+
+// stores compiled programs by their source code, so a program sent many times is parsed and linked only once
+// when the cache is full, the least recently used program is removed
+class ProgramCache
+{
+private:
+    size_t capacity;
+    // source codes, the most recently used first
+    std::list<std::string> order;
+    std::unordered_map<std::string, std::pair<std::shared_ptr<const Bytecode>, std::list<std::string>::iterator>> programs;
+    std::mutex mutex;
+    uint64_t hits;
+    uint64_t misses;
+public:
+    explicit ProgramCache(size_t capacity);
+
+    // returns the compiled program, compiles it if it is not cached; compilation errors are thrown and not cached
+    std::shared_ptr<const Bytecode> get(const std::string& program);
+    uint64_t getHits();
+    uint64_t getMisses();
+};
+
+ProgramCache::ProgramCache(size_t capacity)
+    : capacity(std::max<size_t>(capacity, 1))
+{
+    this->order = {};
+    this->programs = {};
+    this->hits = 0;
+    this->misses = 0;
+}
+
+std::shared_ptr<const Bytecode> ProgramCache::get(const std::string& program)
+{
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        auto it = this->programs.find(program);
+        if (it != this->programs.end()) {
+            this->hits++;
+            metrics.cacheHits++;
+            this->order.splice(this->order.begin(), this->order, it->second.second);
+            return it->second.first;
+        }
+        this->misses++;
+        metrics.cacheMisses++;
+    }
+
+    // compile without holding the lock, so other programs can be served in the meantime
+    std::shared_ptr<const Bytecode> bytecode = std::make_shared<const Bytecode>(Interpreter::compile(program));
+
+    std::lock_guard<std::mutex> lock(this->mutex);
+    if (this->programs.find(program) == this->programs.end()) {
+        if (this->programs.size() >= this->capacity) {
+            this->programs.erase(this->order.back());
+            this->order.pop_back();
+        }
+        this->order.push_front(program);
+        this->programs[program] = {bytecode, this->order.begin()};
+    }
+    return bytecode;
+}
+
+uint64_t ProgramCache::getHits()
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    return this->hits;
+}
+
+uint64_t ProgramCache::getMisses()
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    return this->misses;
+}
+
+#ifndef _WIN32
+// coordinator/worker mode
+//
+// The coordinator compiles the program once, listens for workers and ships them the bytecode as the first message.
+// Then it streams jobs (initial register values) to the workers, keeping a few jobs in flight per worker,
+// and prints the results in the order of jobs. Jobs of a worker which disconnects are given to other workers.
+//
+// Every message is a header line followed by a payload. The last field of the header is the length of the payload:
+//   coordinator -> worker:   "BYTECODE <instruction limit> <length>", "JOB <id> <length>", "QUIT 0"
+//   worker -> coordinator:   "OK <id> <length>" (payload is the output), "ERR <id> <length>" (payload is the error)
+
+// extracts a complete message from the beginning of received data, returns false if the message is not complete yet
+bool extractMessage(std::string& buffer, std::string& header, std::string& payload)
+{
+    size_t end = buffer.find('\n');
+    if (end == std::string::npos) return false;
+
+    std::string line = buffer.substr(0, end);
+    size_t pos = line.find_last_of(' ');
+    size_t length = 0;
+    try {
+        length = static_cast<size_t>(std::stoul(line.substr(pos + 1)));
+    } catch (const std::logic_error&) {
+        throw "ERROR::CONNECTION::INVALID_HEADER: " + line;
+    }
+
+    if (buffer.length() < end + 1 + length) return false;
+    header = pos == std::string::npos ? "" : line.substr(0, pos);
+    payload = buffer.substr(end + 1, length);
+    buffer.erase(0, end + 1 + length);
+    return true;
+}
+
+class Connection
+{
+private:
+    int fd;
+    // received data which is not yet consumed
+    std::string buffer;
+public:
+    explicit Connection(int fd);
+    ~Connection();
+    Connection(const Connection&) = delete;
+    Connection& operator=(const Connection&) = delete;
+
+    int getFd() const;
+
+    // receives available data, returns false if the connection is closed
+    bool receive();
+    // extracts a complete message from the received data, returns false if there is none yet
+    bool nextMessage(std::string& header, std::string& payload);
+    // blocks until a message is received, returns false if the connection is closed
+    bool readMessage(std::string& header, std::string& payload);
+    bool sendMessage(const std::string& header, const std::string& payload);
+};
+
+Connection::Connection(int fd)
+    : fd(fd)
+{
+    this->buffer = "";
+}
+
+Connection::~Connection()
+{
+    close(this->fd);
+}
+
+int Connection::getFd() const
+{
+    return this->fd;
+}
+
+bool Connection::receive()
+{
+    char data[65536];
+    ssize_t received = recv(this->fd, data, sizeof(data), 0);
+    if (received <= 0) return false;
+    this->buffer.append(data, static_cast<size_t>(received));
+    return true;
+}
+
+bool Connection::nextMessage(std::string& header, std::string& payload)
+{
+    return extractMessage(this->buffer, header, payload);
+}
+
+bool Connection::readMessage(std::string& header, std::string& payload)
+{
+    while (!this->nextMessage(header, payload)) {
+        if (!this->receive()) return false;
+    }
+    return true;
+}
+
+bool Connection::sendMessage(const std::string& header, const std::string& payload)
+{
+    std::string data = header + " " + std::to_string(payload.length()) + "\n" + payload;
+    size_t sent = 0;
+    while (sent < data.length()) {
+        ssize_t n = send(this->fd, data.data() + sent, data.length() - sent, 0);
+        if (n <= 0) return false;
+        sent += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+class Coordinator
+{
+private:
+    // number of jobs sent to a worker before waiting for its results
+    static const size_t jobsInFlight = 32;
+    // number of times a job is sent to workers before it is reported as failed
+    static const int maxAttempts = 3;
+
+    std::string bytecode;
+    std::vector<std::string> jobs;
+    // sent to workers with the bytecode, so a job which never ends fails there
+    uint64_t instructionLimit;
+    // a worker which does not finish its oldest job in time is dropped and its jobs are given to other workers
+    std::chrono::seconds timeout;
+
+    struct worker {
+        std::unique_ptr<Connection> connection;
+        std::vector<size_t> jobs;   // ids of jobs sent to the worker
+        // when the oldest job of the worker has to be finished, the worker runs jobs in the order they were sent
+        std::chrono::steady_clock::time_point deadline;
+    };
+    std::vector<worker> workers;
+
+    std::deque<size_t> pendingJobs;
+    std::vector<int> attempts;
+    std::vector<std::string> results;
+    std::vector<bool> isDone;
+    size_t nextResult;
+
+    void dispatchJobs(worker& w);
+    void dropWorker(size_t index, const std::string& reason);
+    void printResults(std::ostream& out);
+public:
+    Coordinator(const Bytecode& bytecode, const std::vector<std::vector<std::pair<std::string, int>>>& jobs, uint64_t instructionLimit, std::chrono::seconds timeout);
+    void run(unsigned short port, std::ostream& out);
+};
+
+Coordinator::Coordinator(const Bytecode& bytecode, const std::vector<std::vector<std::pair<std::string, int>>>& jobs, uint64_t instructionLimit, std::chrono::seconds timeout)
+    : instructionLimit(instructionLimit), timeout(timeout)
+{
+    this->bytecode = bytecode.serialize();
+    this->jobs = {};
+    for (const auto& job : jobs) {
+        std::string payload = "";
+        for (const auto& reg : job) payload += reg.first + " " + std::to_string(reg.second) + " ";
+        this->jobs.push_back(payload);
+    }
+    this->workers.clear();
+    this->pendingJobs = {};
+    for (size_t i = 0; i < this->jobs.size(); ++i) this->pendingJobs.push_back(i);
+    this->attempts = std::vector<int>(this->jobs.size(), 0);
+    this->results = std::vector<std::string>(this->jobs.size(), "");
+    this->isDone = std::vector<bool>(this->jobs.size(), false);
+    this->nextResult = 0;
+}
+
+void Coordinator::dispatchJobs(worker& w)
+{
+    if (w.jobs.empty()) w.deadline = std::chrono::steady_clock::now() + this->timeout;
+    while (w.jobs.size() < Coordinator::jobsInFlight && !this->pendingJobs.empty()) {
+        size_t id = this->pendingJobs.front();
+        this->pendingJobs.pop_front();
+        this->attempts[id]++;
+        w.jobs.push_back(id);
+        // a failed send is detected as a closed connection by poll()
+        w.connection->sendMessage("JOB " + std::to_string(id), this->jobs[id]);
+    }
+}
+
+void Coordinator::dropWorker(size_t index, const std::string& reason)
+{
+    // give the unfinished jobs of the worker to other workers
+    // only the oldest one was running, so only its attempt counts; a job which stops its workers fails after `maxAttempts` of them
+    const std::vector<size_t>& jobs = this->workers[index].jobs;
+    for (size_t i = 1; i < jobs.size(); ++i) this->attempts[jobs[i]]--;
+    for (size_t id : jobs) {
+        if (this->isDone[id]) continue;
+        if (this->attempts[id] >= Coordinator::maxAttempts) {
+            this->results[id] = "ERROR::COORDINATOR::JOB_FAILED: " + std::to_string(this->attempts[id]) + " attempts";
+            this->isDone[id] = true;
+        } else {
+            this->pendingJobs.push_front(id);
+        }
+    }
+    this->workers.erase(this->workers.begin() + static_cast<std::ptrdiff_t>(index));
+    std::cerr << "Worker " << reason << ", " << this->workers.size() << " left\n";
+}
+
+void Coordinator::printResults(std::ostream& out)
+{
+    while (this->nextResult < this->jobs.size() && this->isDone[this->nextResult]) {
+        out << this->nextResult << '\t' << this->results[this->nextResult] << '\n';
+        this->nextResult++;
+    }
+    out.flush();
+}
+
+void Coordinator::run(unsigned short port, std::ostream& out)
+{
+    int listener = socket(AF_INET6, SOCK_STREAM, 0);
+    if (listener < 0) throw std::string("ERROR::COORDINATOR::CAN_NOT_CREATE_SOCKET");
+    Connection listenerGuard(listener);
+
+    int option = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &option, sizeof(option));
+    option = 0;
+    setsockopt(listener, IPPROTO_IPV6, IPV6_V6ONLY, &option, sizeof(option));
+
+    sockaddr_in6 address{};
+    address.sin6_family = AF_INET6;
+    address.sin6_addr = in6addr_any;
+    address.sin6_port = htons(port);
+    if (bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 || listen(listener, 64) < 0) {
+        throw "ERROR::COORDINATOR::CAN_NOT_LISTEN: " + std::to_string(port);
+    }
+    std::cerr << "Waiting for workers on port " << port << ", " << this->jobs.size() << " jobs\n";
+
+    while (this->nextResult < this->jobs.size()) {
+        std::vector<pollfd> fds{{listener, POLLIN, 0}};
+        for (const worker& w : this->workers) fds.push_back({w.connection->getFd(), POLLIN, 0});
+
+        // wait until the earliest deadline of a worker with unfinished jobs at most
+        auto now = std::chrono::steady_clock::now();
+        int wait = -1;
+        for (const worker& w : this->workers) {
+            if (w.jobs.empty()) continue;
+            auto left = std::chrono::duration_cast<std::chrono::milliseconds>(w.deadline - now).count() + 1;
+            wait = static_cast<int>(std::max<long long>(0, wait < 0 ? left : std::min<long long>(wait, left)));
+        }
+        if (poll(fds.data(), fds.size(), wait) < 0) continue;
+
+        // workers are checked in reverse order, so dropping a worker does not change indices of the remaining ones
+        for (size_t i = fds.size() - 1; i > 0; --i) {
+            if (fds[i].revents == 0) continue;
+            worker& w = this->workers[i - 1];
+
+            bool isConnected = w.connection->receive();
+            std::string header = "";
+            std::string payload = "";
+            try {
+                while (isConnected && w.connection->nextMessage(header, payload)) {
+                    std::stringstream ss(header);
+                    std::string status = "";
+                    size_t id = 0;
+                    ss >> status >> id;
+
+                    auto it = std::find(w.jobs.begin(), w.jobs.end(), id);
+                    if ((status != "OK" && status != "ERR") || it == w.jobs.end()) {
+                        isConnected = false;
+                        break;
+                    }
+                    if (it == w.jobs.begin()) w.deadline = std::chrono::steady_clock::now() + this->timeout;
+                    w.jobs.erase(it);
+                    if (!this->isDone[id]) {
+                        this->results[id] = payload;
+                        this->isDone[id] = true;
+                    }
+                }
+            } catch (const std::string&) {
+                isConnected = false;
+            }
+
+            if (isConnected) {
+                this->dispatchJobs(w);
+            } else {
+                this->dropWorker(i - 1, "disconnected");
+            }
+        }
+
+        // the connection of a worker which missed its deadline is closed, its job is run again by another worker
+        now = std::chrono::steady_clock::now();
+        for (size_t i = this->workers.size(); i-- > 0;) {
+            if (!this->workers[i].jobs.empty() && this->workers[i].deadline <= now) this->dropWorker(i, "timed out");
+        }
+
+        if (fds[0].revents & POLLIN) {
+            int fd = accept(listener, nullptr, nullptr);
+            if (fd >= 0) {
+                int noDelay = 1;
+                setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+                this->workers.push_back(worker{std::unique_ptr<Connection>(new Connection(fd)), {}, std::chrono::steady_clock::now()});
+                worker& w = this->workers.back();
+                std::cerr << "Worker connected, " << this->workers.size() << " total\n";
+                if (w.connection->sendMessage("BYTECODE " + std::to_string(this->instructionLimit), this->bytecode)) this->dispatchJobs(w);
+            }
+        }
+
+        // jobs returned by dropped workers
+        for (worker& w : this->workers) this->dispatchJobs(w);
+
+        this->printResults(out);
+    }
+
+    for (worker& w : this->workers) w.connection->sendMessage("QUIT", "");
+}
+
+void runWorker(const std::string& host, const std::string& port)
+{
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* addresses = nullptr;
+    if (getaddrinfo(host.c_str(), port.c_str(), &hints, &addresses) != 0) throw "ERROR::WORKER::CAN_NOT_RESOLVE: " + host;
+
+    int fd = -1;
+    for (addrinfo* a = addresses; a != nullptr && fd < 0; a = a->ai_next) {
+        fd = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+        if (fd >= 0 && connect(fd, a->ai_addr, a->ai_addrlen) < 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(addresses);
+    if (fd < 0) throw "ERROR::WORKER::CAN_NOT_CONNECT: " + host + ":" + port;
+
+    int noDelay = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+    Connection connection(fd);
+
+    std::string header = "";
+    std::string payload = "";
+    if (!connection.readMessage(header, payload) || header.compare(0, 8, "BYTECODE") != 0) throw std::string("ERROR::WORKER::BYTECODE_EXPECTED");
+    std::stringstream limit(header.substr(8));
+    uint64_t instructionLimit = UINT64_MAX;
+    limit >> instructionLimit;
+
+    std::shared_ptr<const Bytecode> bytecode = std::make_shared<const Bytecode>(Bytecode::deserialize(payload));
+    BytecodeEngine engine(bytecode);
+    engine.setInstructionLimit(instructionLimit);
+    // slots of input registers, by name
+    std::unordered_map<std::string, int> slots{};
+
+    while (connection.readMessage(header, payload)) {
+        std::stringstream ss(header);
+        std::string type = "";
+        std::string id = "";
+        ss >> type >> id;
+        if (type != "JOB") break;
+
+        std::stringstream inputs(payload);
+        std::string name = "";
+        int value = 0;
+        engine.reset();
+        while (inputs >> name >> value) {
+            auto it = slots.find(name);
+            if (it == slots.end()) it = slots.insert({name, bytecode->findRegister(name)}).first;
+            if (it->second >= 0) engine.setRegister(it->second, value);
+        }
+
+        bool isSent = false;
+        try {
+            engine.run();
+            isSent = connection.sendMessage("OK " + id, engine.getOutput());
+        } catch (const std::string& e) {
+            isSent = connection.sendMessage("ERR " + id, e);
+        } catch (const std::exception& e) {
+            isSent = connection.sendMessage("ERR " + id, std::string("ERROR::WORKER::EXCEPTION: ") + e.what());
+        }
+        if (!isSent) break;
+    }
+}
+#endif
+
+// reductions
+//
+// A reduction aggregates a final register value of the matching runs of a batch, e.g. "sum:c".
+// Every thread reduces into its own copy, the copies are merged once all runs are finished.
+
+class Reduction
+{
+private:
+    enum Kind { COUNT, SUM, MIN, MAX, HISTOGRAM } kind;
+    std::string spec;
+    int slot;
+    long long bucketWidth;
+
+    unsigned long long count;
+    long long sum;
+    int min;
+    int max;
+    // number of values by the lowest value of a bucket
+    std::map<long long, unsigned long long> histogram;
+public:
+    // "count", "sum:reg", "min:reg", "max:reg", "hist:reg:width"
+    Reduction(const std::string& spec, const Bytecode& bytecode);
+
+    void add(const BytecodeEngine& engine);
+    void merge(const Reduction& other);
+    void print(std::ostream& out) const;
+};
+
+Reduction::Reduction(const std::string& spec, const Bytecode& bytecode)
+    : spec(spec)
+{
+    this->slot = -1;
+    this->bucketWidth = 1;
+    this->count = 0;
+    this->sum = 0;
+    this->min = 0;
+    this->max = 0;
+    this->histogram = {};
+
+    std::vector<std::string> parts{};
+    std::stringstream ss(spec);
+    std::string part = "";
+    while (std::getline(ss, part, ':')) parts.push_back(part);
+
+    std::unordered_map<std::string, Kind> kindMap{
+        { "count", Kind::COUNT },
+        { "sum", Kind::SUM },
+        { "min", Kind::MIN },
+        { "max", Kind::MAX },
+        { "hist", Kind::HISTOGRAM }
+    };
+    auto it = parts.empty() ? kindMap.end() : kindMap.find(parts[0]);
+    if (it == kindMap.end()) throw "ERROR::REDUCTION::UNKNOWN_REDUCTION: " + spec;
+    this->kind = it->second;
+
+    size_t expectedParts = this->kind == Kind::COUNT ? 1 : this->kind == Kind::HISTOGRAM ? 3 : 2;
+    if (parts.size() != expectedParts) throw "ERROR::REDUCTION::INVALID_REDUCTION: " + spec;
+
+    if (this->kind != Kind::COUNT) {
+        this->slot = bytecode.findRegister(parts[1]);
+        if (this->slot < 0) throw "ERROR::REDUCTION::UNKNOWN_REGISTER: " + parts[1];
+    }
+    if (this->kind == Kind::HISTOGRAM) {
+        try {
+            this->bucketWidth = std::stoll(parts[2]);
+        } catch (const std::logic_error&) {
+            this->bucketWidth = 0;
+        }
+        if (this->bucketWidth <= 0) throw "ERROR::REDUCTION::INVALID_BUCKET_WIDTH: " + parts[2];
+    }
+}
+
+void Reduction::add(const BytecodeEngine& engine)
+{
+    int value = this->slot < 0 ? 0 : engine.getRegister(this->slot);
+    switch (this->kind)
+    {
+    case Kind::SUM:
+        this->sum += value;
+        break;
+    case Kind::MIN:
+        if (this->count == 0 || value < this->min) this->min = value;
+        break;
+    case Kind::MAX:
+        if (this->count == 0 || value > this->max) this->max = value;
+        break;
+    case Kind::HISTOGRAM: {
+        // buckets are aligned to multiples of the width, also for negative values
+        long long bucket = value >= 0 ? value / this->bucketWidth : -((-static_cast<long long>(value) - 1) / this->bucketWidth) - 1;
+        this->histogram[bucket * this->bucketWidth]++;
+        break;
+    }
+    default:
+        break;
+    }
+    this->count++;
+}
+
+void Reduction::merge(const Reduction& other)
+{
+    if (other.count == 0) return;
+    if (this->count == 0 || other.min < this->min) this->min = other.min;
+    if (this->count == 0 || other.max > this->max) this->max = other.max;
+    this->count += other.count;
+    this->sum += other.sum;
+    for (const auto& bucket : other.histogram) this->histogram[bucket.first] += bucket.second;
+}
+
+void Reduction::print(std::ostream& out) const
+{
+    switch (this->kind)
+    {
+    case Kind::COUNT:
+        out << this->spec << '\t' << this->count << '\n';
+        break;
+    case Kind::SUM:
+        out << this->spec << '\t' << this->sum << '\n';
+        break;
+    case Kind::MIN:
+        out << this->spec << '\t' << (this->count > 0 ? std::to_string(this->min) : "none") << '\n';
+        break;
+    case Kind::MAX:
+        out << this->spec << '\t' << (this->count > 0 ? std::to_string(this->max) : "none") << '\n';
+        break;
+    case Kind::HISTOGRAM:
+        for (const auto& bucket : this->histogram) out << this->spec << '\t' << bucket.first << '\t' << bucket.second << '\n';
+        break;
+    }
+}
+
+// parameter sweeps
+//
+// A sweep runs a program for every combination of initial register values from the given ranges (cartesian product).
+// Combinations are never stored: every thread claims a chunk of combination numbers and generates their values like an odometer.
+// A predicate is evaluated on the final registers of every run; the sweep can stop after finding the first `limit` matches.
+// With reductions, the matching runs are aggregated instead of printed and messages of the program are not created.
+
+class Sweep
+{
+private:
+    // number of runs claimed by a thread at once
+    static constexpr unsigned long long maxChunkSize = 1024;
+
+    // values first, first + step, ..., first + (count - 1) * step of a register
+    struct range {
+        std::string name;
+        int slot;
+        long long first;
+        long long step;
+        unsigned long long count;
+    };
+    // compares a final register value to a constant or another register
+    struct condition {
+        int slot;
+        std::string op;
+        Bytecode::operand value;
+    };
+    struct match {
+        unsigned long long index;
+        std::vector<int> inputs;
+        std::string output;
+    };
+
+    std::shared_ptr<const Bytecode> bytecode;
+    std::vector<Sweep::range> ranges;
+    std::vector<Sweep::condition> conditions;
+    // threads start from the empty `reductions` and merge their results into `totals`
+    std::vector<Reduction> reductions;
+    std::vector<Reduction> totals;
+    // number of combinations of all ranges
+    unsigned long long runCount;
+
+    // state shared by threads while running
+    std::atomic<unsigned long long> nextRun;
+    // runs with a greater index can not be among the first `limit` matches
+    std::atomic<unsigned long long> lastUsefulRun;
+    std::atomic<unsigned long long> executedRuns;
+    std::atomic<unsigned long long> matchedRuns;
+    std::mutex mutex;
+    // with a limit, the first matches found so far
+    std::vector<Sweep::match> matches;
+    // without a limit, matches are printed by chunks in the order of the sweep: the text of chunks which finished before an earlier one
+    // waits until all earlier chunks are printed, and threads do not start chunks too far ahead of the printed ones
+    std::map<unsigned long long, std::string> finishedChunks;
+    unsigned long long printedChunks;
+    unsigned long long maxBufferedChunks;
+    std::condition_variable chunkPrinted;
+    std::ostream* out;
+    unsigned long long failedRuns;
+    std::string firstError;
+
+    int findRegister(const std::string& name) const;
+    bool isMatch(const BytecodeEngine& engine) const;
+    void formatMatch(std::string& text, const std::vector<int>& inputs, const std::string& output) const;
+    void addMatch(Sweep::match&& m, unsigned long long limit);
+    void finishChunk(unsigned long long chunk, std::string&& text);
+    void runThread(unsigned long long chunkSize, unsigned long long limit);
+public:
+    // ranges are written as "name=first..last" or "name=first..last:step"
+    // a predicate is a list of conditions joined by "&&", e.g. "c==5 && b>a"; an empty predicate matches every run
+    // reductions are written as described in Reduction
+    Sweep(std::shared_ptr<const Bytecode> bytecode, const std::vector<std::string>& ranges, const std::string& predicate, const std::vector<std::string>& reductions);
+
+    // prints the first `limit` matches (0 means no limit) in the order of the sweep, or the results of reductions
+    void run(size_t threadCount, unsigned long long limit, std::ostream& out);
+};
+
+Sweep::Sweep(std::shared_ptr<const Bytecode> bytecode, const std::vector<std::string>& ranges, const std::string& predicate, const std::vector<std::string>& reductions)
+    : bytecode(bytecode)
+{
+    this->ranges = {};
+    this->conditions = {};
+    this->reductions = {};
+    for (const std::string& spec : reductions) this->reductions.push_back(Reduction(spec, *bytecode));
+    this->runCount = 1;
+    this->failedRuns = 0;
+    this->firstError = "";
+
+    for (const std::string& spec : ranges) {
+        size_t equals = spec.find('=');
+        size_t dots = spec.find("..");
+        size_t colon = spec.find(':');
+        if (equals == std::string::npos || dots == std::string::npos || dots < equals) throw "ERROR::SWEEP::INVALID_RANGE: " + spec;
+
+        Sweep::range r{};
+        r.name = spec.substr(0, equals);
+        r.slot = this->findRegister(r.name);
+        long long last = 0;
+        // every number must be used entirely, so "1x..3" is not read as "1..3"
+        auto toNumber = [&](const std::string& number) -> int {
+            size_t length = 0;
+            int value = std::stoi(number, &length);
+            if (length != number.length()) throw std::invalid_argument(number);
+            return value;
+        };
+        try {
+            r.first = toNumber(spec.substr(equals + 1, dots - equals - 1));
+            last = toNumber(spec.substr(dots + 2, colon == std::string::npos ? std::string::npos : colon - dots - 2));
+            r.step = colon == std::string::npos ? 1 : toNumber(spec.substr(colon + 1));
+        } catch (const std::logic_error&) {
+            throw "ERROR::SWEEP::INVALID_RANGE: " + spec;
+        }
+        if (r.step <= 0 || last < r.first) throw "ERROR::SWEEP::INVALID_RANGE: " + spec;
+        r.count = static_cast<unsigned long long>((last - r.first) / r.step + 1);
+
+        if (this->runCount > ~0ULL / r.count) throw std::string("ERROR::SWEEP::TOO_MANY_RUNS");
+        this->runCount *= r.count;
+        this->ranges.push_back(r);
+    }
+
+    std::string text = "";
+    for (char c : predicate) {
+        if (c != ' ' && c != '\t') text += c;
+    }
+    size_t begin = 0;
+    while (begin < text.length()) {
+        size_t end = text.find("&&", begin);
+        std::string cond = text.substr(begin, end == std::string::npos ? std::string::npos : end - begin);
+        begin = end == std::string::npos ? text.length() : end + 2;
+
+        size_t pos = cond.find_first_of("=!<>");
+        if (pos == std::string::npos || pos == 0) throw "ERROR::SWEEP::INVALID_CONDITION: " + cond;
+        size_t opLength = pos + 1 < cond.length() && cond[pos + 1] == '=' ? 2 : 1;
+
+        Sweep::condition c{};
+        c.slot = this->findRegister(cond.substr(0, pos));
+        c.op = cond.substr(pos, opLength);
+        if (c.op == "=" || c.op == "!") throw "ERROR::SWEEP::INVALID_CONDITION: " + cond;
+
+        std::string value = cond.substr(pos + opLength);
+        if (!value.empty() && value.find_first_not_of("abcdefghijklmnopqrstuvwxyz") == std::string::npos) {
+            c.value = {true, this->findRegister(value)};
+        } else {
+            try {
+                size_t length = 0;
+                c.value = {false, std::stoi(value, &length)};
+                if (length != value.length()) throw std::invalid_argument(value);
+            } catch (const std::logic_error&) {
+                throw "ERROR::SWEEP::INVALID_CONDITION: " + cond;
+            }
+        }
+        this->conditions.push_back(c);
+    }
+}
+
+int Sweep::findRegister(const std::string& name) const
+{
+    int slot = this->bytecode->findRegister(name);
+    if (slot < 0) throw "ERROR::SWEEP::UNKNOWN_REGISTER: " + name;
+    return slot;
+}
+
+bool Sweep::isMatch(const BytecodeEngine& engine) const
+{
+    for (const Sweep::condition& c : this->conditions) {
+        int left = engine.getRegister(c.slot);
+        int right = c.value.isRegister ? engine.getRegister(c.value.value) : c.value.value;
+        bool result = false;
+        if (c.op == "==") result = left == right;
+        else if (c.op == "!=") result = left != right;
+        else if (c.op == "<") result = left < right;
+        else if (c.op == "<=") result = left <= right;
+        else if (c.op == ">") result = left > right;
+        else if (c.op == ">=") result = left >= right;
+        if (!result) return false;
+    }
+    return true;
+}
+
+void Sweep::formatMatch(std::string& text, const std::vector<int>& inputs, const std::string& output) const
+{
+    for (size_t i = 0; i < this->ranges.size(); ++i) text += (i > 0 ? " " : "") + this->ranges[i].name + '=' + std::to_string(inputs[i]);
+    text += '\t' + output + '\n';
+}
+
+void Sweep::addMatch(Sweep::match&& m, unsigned long long limit)
+{
+    // `matches` is a max-heap by index, so the latest of the first `limit` matches is replaced in logarithmic time
+    auto isEarlier = [](const Sweep::match& a, const Sweep::match& b) -> bool { return a.index < b.index; };
+
+    std::lock_guard<std::mutex> lock(this->mutex);
+    if (this->matches.size() < limit) {
+        this->matches.push_back(std::move(m));
+        std::push_heap(this->matches.begin(), this->matches.end(), isEarlier);
+    } else if (m.index < this->matches.front().index) {
+        std::pop_heap(this->matches.begin(), this->matches.end(), isEarlier);
+        this->matches.back() = std::move(m);
+        std::push_heap(this->matches.begin(), this->matches.end(), isEarlier);
+    }
+    // once there are `limit` matches, later runs can not replace them anymore
+    if (this->matches.size() == limit) this->lastUsefulRun = this->matches.front().index;
+}
+
+void Sweep::finishChunk(unsigned long long chunk, std::string&& text)
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->finishedChunks.emplace(chunk, std::move(text));
+    auto it = this->finishedChunks.begin();
+    if (it->first != this->printedChunks) return;
+    for (; it != this->finishedChunks.end() && it->first == this->printedChunks; it = this->finishedChunks.erase(it)) {
+        *this->out << it->second;
+        this->printedChunks++;
+    }
+    this->chunkPrinted.notify_all();
+}
+
+void Sweep::runThread(unsigned long long chunkSize, unsigned long long limit)
+{
+    BytecodeEngine engine(this->bytecode);
+    std::vector<unsigned long long> digits(this->ranges.size(), 0);
+    std::vector<int> values(this->ranges.size(), 0);
+    unsigned long long executed = 0;
+    unsigned long long matched = 0;
+    std::vector<Reduction> partials = this->reductions;
+    const bool isReducing = !partials.empty();
+    const bool isStreaming = !isReducing && limit == 0;
+    std::string text = "";
+
+    while (true) {
+        if (isStreaming) {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            this->chunkPrinted.wait(lock, [&]() -> bool {
+                unsigned long long next = this->nextRun.load();
+                return next >= this->runCount || next / chunkSize < this->printedChunks + this->maxBufferedChunks;
+            });
+        }
+        unsigned long long start = this->nextRun.fetch_add(chunkSize);
+        if (start >= this->runCount || start > this->lastUsefulRun) break;
+        unsigned long long end = std::min(start + chunkSize, this->runCount);
+
+        // the last range changes the fastest
+        unsigned long long rest = start;
+        for (size_t i = this->ranges.size(); i-- > 0;) {
+            digits[i] = rest % this->ranges[i].count;
+            rest /= this->ranges[i].count;
+            values[i] = static_cast<int>(this->ranges[i].first + static_cast<long long>(digits[i]) * this->ranges[i].step);
+        }
+
+        for (unsigned long long index = start; index < end; ++index) {
+            if (index > this->lastUsefulRun.load(std::memory_order_relaxed)) break;
+
+            engine.reset();
+            for (size_t i = 0; i < this->ranges.size(); ++i) engine.setRegister(this->ranges[i].slot, values[i]);
+
+            executed++;
+            try {
+                engine.run(!isReducing);
+                if (this->isMatch(engine)) {
+                    matched++;
+                    if (isReducing) {
+                        for (Reduction& r : partials) r.add(engine);
+                    } else if (isStreaming) {
+                        this->formatMatch(text, values, engine.getOutput());
+                    } else {
+                        this->addMatch({index, values, engine.getOutput()}, limit);
+                    }
+                }
+            } catch (const std::string& e) {
+                std::lock_guard<std::mutex> lock(this->mutex);
+                if (this->failedRuns++ == 0) this->firstError = e;
+            }
+
+            for (size_t i = this->ranges.size(); i-- > 0;) {
+                if (++digits[i] < this->ranges[i].count) {
+                    values[i] = static_cast<int>(values[i] + this->ranges[i].step);
+                    break;
+                }
+                digits[i] = 0;
+                values[i] = static_cast<int>(this->ranges[i].first);
+            }
+        }
+
+        if (isStreaming) {
+            this->finishChunk(start / chunkSize, std::move(text));
+            text = "";
+        }
+    }
+
+    this->executedRuns += executed;
+    this->matchedRuns += matched;
+
+    std::lock_guard<std::mutex> lock(this->mutex);
+    for (size_t i = 0; i < partials.size(); ++i) this->totals[i].merge(partials[i]);
+}
+
+void Sweep::run(size_t threadCount, unsigned long long limit, std::ostream& out)
+{
+    // reductions of the first `limit` matches would need to know which partial results come from runs past the limit
+    if (limit > 0 && !this->reductions.empty()) throw std::string("ERROR::SWEEP::LIMIT_WITH_REDUCTIONS");
+
+    auto startTime = std::chrono::steady_clock::now();
+
+    this->nextRun = 0;
+    this->lastUsefulRun = ~0ULL;
+    this->executedRuns = 0;
+    this->matchedRuns = 0;
+    this->matches = {};
+    this->totals = this->reductions;
+    this->finishedChunks = {};
+    this->printedChunks = 0;
+    this->out = &out;
+    this->failedRuns = 0;
+    this->firstError = "";
+
+    threadCount = std::max<size_t>(threadCount, 1);
+    this->maxBufferedChunks = threadCount * 4;
+    unsigned long long chunkSize = std::max<unsigned long long>(1, std::min(Sweep::maxChunkSize, this->runCount / (threadCount * 16)));
+
+    std::vector<std::thread> threads{};
+    for (size_t i = 0; i < threadCount; ++i) threads.emplace_back(&Sweep::runThread, this, chunkSize, limit);
+    for (std::thread& t : threads) t.join();
+
+    std::sort(this->matches.begin(), this->matches.end(), [](const Sweep::match& a, const Sweep::match& b) { return a.index < b.index; });
+
+    std::string text = "";
+    for (const Sweep::match& m : this->matches) this->formatMatch(text, m.inputs, m.output);
+    out << text;
+    for (const Reduction& r : this->totals) r.print(out);
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    std::cerr << this->executedRuns << " of " << this->runCount << " runs, " << this->matchedRuns << " matches, "
+              << this->failedRuns << " failed, " << seconds << " s\n";
+    if (this->failedRuns > 0) std::cerr << "First error: " << this->firstError << '\n';
+}
+
+// columnar files
+//
+// A column file stores one contiguous array of 32-bit integers per column (e.g. per register), in the native byte order:
+//   "ASMCOLS1"                              8 bytes
+//   column count, reserved                  2 x uint32
+//   row count                               uint64
+//   column names                            uint32 length followed by the name, for every column
+//   padding to a multiple of 64 bytes
+//   columns                                 row count x int32, for every column
+// Files are memory-mapped, so batch runs read inputs and write results in place without copying them.
+
+class ColumnFile
+{
+private:
+    static const size_t alignment = 64;
+
+    std::vector<std::string> names;
+    uint64_t rowCount;
+    size_t dataOffset;
+
+    std::string path;
+    char* data;
+    size_t size;
+    bool isWritable;
+#ifdef _WIN32
+    // without mmap the file is read into memory and written back when it is closed
+    std::vector<char> buffer;
+#endif
+
+    void open(size_t size);
+public:
+    // maps an existing file for reading
+    explicit ColumnFile(const std::string& path);
+    // creates a file with the given columns (all values are 0) and maps it for writing
+    ColumnFile(const std::string& path, const std::vector<std::string>& names, uint64_t rowCount);
+    ~ColumnFile();
+    ColumnFile(const ColumnFile&) = delete;
+    ColumnFile& operator=(const ColumnFile&) = delete;
+
+    const std::vector<std::string>& getNames() const;
+    uint64_t getRowCount() const;
+    // returns the index of a column or -1 if there is no such column
+    int findColumn(const std::string& name) const;
+
+    const int32_t* column(size_t index) const;
+    int32_t* column(size_t index);
+};
+
+void ColumnFile::open(size_t size)
+{
+    this->size = size;
+#ifndef _WIN32
+    int fd = this->isWritable ? ::open(this->path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644) : ::open(this->path.c_str(), O_RDONLY);
+    if (fd < 0) throw "ERROR::FILE::CAN_NOT_OPEN: " + this->path;
+
+    if (this->isWritable) {
+        if (ftruncate(fd, static_cast<off_t>(size)) < 0) {
+            ::close(fd);
+            throw "ERROR::FILE::CAN_NOT_WRITE: " + this->path;
+        }
+    } else {
+        struct stat info{};
+        fstat(fd, &info);
+        this->size = static_cast<size_t>(info.st_size);
+    }
+
+    void* mapping = this->size == 0 ? MAP_FAILED : mmap(nullptr, this->size, this->isWritable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) throw "ERROR::COLUMN_FILE::CAN_NOT_MAP: " + this->path;
+    this->data = static_cast<char*>(mapping);
+#else
+    if (this->isWritable) {
+        this->buffer = std::vector<char>(size, 0);
+    } else {
+        std::string content = readFile(this->path);
+        this->buffer = std::vector<char>(content.begin(), content.end());
+        this->size = this->buffer.size();
+    }
+    this->data = this->buffer.data();
+#endif
+}
+
+ColumnFile::ColumnFile(const std::string& path)
+    : path(path)
+{
+    this->names = {};
+    this->isWritable = false;
+    this->open(0);
+
+    auto invalid = [&]() -> std::string { return "ERROR::COLUMN_FILE::INVALID_FORMAT: " + this->path; };
+    size_t pos = 0;
+    auto read = [&](void* value, size_t length) -> void {
+        if (this->size - pos < length) throw invalid();
+        std::memcpy(value, this->data + pos, length);
+        pos += length;
+    };
+
+    char magic[8];
+    uint32_t columnCount = 0;
+    uint32_t reserved = 0;
+    read(magic, sizeof(magic));
+    read(&columnCount, sizeof(columnCount));
+    read(&reserved, sizeof(reserved));
+    read(&this->rowCount, sizeof(this->rowCount));
+    if (std::memcmp(magic, "ASMCOLS1", sizeof(magic)) != 0) throw invalid();
+
+    for (uint32_t i = 0; i < columnCount; ++i) {
+        uint32_t length = 0;
+        read(&length, sizeof(length));
+        if (this->size - pos < length) throw invalid();
+        this->names.push_back(std::string(this->data + pos, length));
+        pos += length;
+    }
+
+    this->dataOffset = (pos + ColumnFile::alignment - 1) / ColumnFile::alignment * ColumnFile::alignment;
+    uint64_t available = this->size >= this->dataOffset ? this->size - this->dataOffset : 0;
+    if (columnCount > 0 && this->rowCount > available / sizeof(int32_t) / columnCount) throw invalid();
+}
+
+ColumnFile::ColumnFile(const std::string& path, const std::vector<std::string>& names, uint64_t rowCount)
+    : names(names), rowCount(rowCount), path(path)
+{
+    this->isWritable = true;
+
+    std::string header = "ASMCOLS1";
+    auto write = [&](const void* value, size_t length) -> void {
+        header.append(static_cast<const char*>(value), length);
+    };
+    uint32_t columnCount = static_cast<uint32_t>(names.size());
+    uint32_t reserved = 0;
+    write(&columnCount, sizeof(columnCount));
+    write(&reserved, sizeof(reserved));
+    write(&rowCount, sizeof(rowCount));
+    for (const std::string& name : names) {
+        uint32_t length = static_cast<uint32_t>(name.length());
+        write(&length, sizeof(length));
+        write(name.data(), name.length());
+    }
+
+    this->dataOffset = (header.length() + ColumnFile::alignment - 1) / ColumnFile::alignment * ColumnFile::alignment;
+    this->open(this->dataOffset + names.size() * rowCount * sizeof(int32_t));
+    std::memcpy(this->data, header.data(), header.length());
+}
+
+ColumnFile::~ColumnFile()
+{
+#ifndef _WIN32
+    munmap(this->data, this->size);
+#else
+    if (this->isWritable) {
+        std::ofstream file(this->path, std::ios::binary);
+        file.write(this->buffer.data(), static_cast<std::streamsize>(this->buffer.size()));
+    }
+#endif
+}
+
+const std::vector<std::string>& ColumnFile::getNames() const
+{
+    return this->names;
+}
+
+uint64_t ColumnFile::getRowCount() const
+{
+    return this->rowCount;
+}
+
+int ColumnFile::findColumn(const std::string& name) const
+{
+    for (size_t i = 0; i < this->names.size(); ++i) {
+        if (this->names[i] == name) return static_cast<int>(i);
+    }
+    return -1;
+}
+
+const int32_t* ColumnFile::column(size_t index) const
+{
+    return reinterpret_cast<const int32_t*>(this->data + this->dataOffset + index * this->rowCount * sizeof(int32_t));
+}
+
+int32_t* ColumnFile::column(size_t index)
+{
+    return reinterpret_cast<int32_t*>(this->data + this->dataOffset + index * this->rowCount * sizeof(int32_t));
+}
+
+void importCsv(const std::string& csvPath, const std::string& columnPath)
+{
+    // The first line of the CSV file contains column names, every other line contains integer values of all columns.
+
+    std::stringstream csv(readFile(csvPath));
+    std::string line = "";
+    auto split = [](const std::string& str) -> std::vector<std::string> {
+        std::vector<std::string> fields{};
+        std::stringstream ss(str);
+        std::string field = "";
+        while (std::getline(ss, field, ',')) {
+            size_t first = field.find_first_not_of(" \t\r");
+            size_t last = field.find_last_not_of(" \t\r");
+            fields.push_back(first == std::string::npos ? "" : field.substr(first, last - first + 1));
+        }
+        return fields;
+    };
+
+    if (!std::getline(csv, line)) throw "ERROR::CSV::MISSING_HEADER: " + csvPath;
+    std::vector<std::string> names = split(line);
+    std::vector<std::vector<int32_t>> columns(names.size());
+
+    size_t lineNumber = 1;
+    while (std::getline(csv, line)) {
+        lineNumber++;
+        if (line.find_first_not_of(" \t\r") == std::string::npos) continue;
+
+        std::vector<std::string> fields = split(line);
+        if (fields.size() != names.size()) throw "ERROR::CSV::INVALID_NUMBER_OF_FIELDS: line " + std::to_string(lineNumber);
+        for (size_t i = 0; i < fields.size(); ++i) {
+            try {
+                size_t length = 0;
+                columns[i].push_back(std::stoi(fields[i], &length));
+                if (length != fields[i].length()) throw std::invalid_argument(fields[i]);
+            } catch (const std::logic_error&) {
+                throw "ERROR::CSV::INVALID_VALUE: line " + std::to_string(lineNumber) + ": " + fields[i];
+            }
+        }
+    }
+
+    ColumnFile file(columnPath, names, columns.empty() ? 0 : columns[0].size());
+    for (size_t i = 0; i < columns.size(); ++i) {
+        if (!columns[i].empty()) std::memcpy(file.column(i), columns[i].data(), columns[i].size() * sizeof(int32_t));
+    }
+}
+
+void exportCsv(const std::string& columnPath, std::ostream& out)
+{
+    ColumnFile file(columnPath);
+    const std::vector<std::string>& names = file.getNames();
+
+    for (size_t i = 0; i < names.size(); ++i) out << (i > 0 ? "," : "") << names[i];
+    out << '\n';
+    for (uint64_t row = 0; row < file.getRowCount(); ++row) {
+        for (size_t i = 0; i < names.size(); ++i) out << (i > 0 ? "," : "") << file.column(i)[row];
+        out << '\n';
+    }
+}
+
+void runColumnBatch(std::shared_ptr<const Bytecode> bytecode, const std::string& inputPath, const std::string& outputPath,
+    const std::vector<std::string>& outputRegisters, const std::vector<std::string>& reductionSpecs, size_t threadCount, std::ostream& out)
+{
+    // This function runs the program once for every row of the input file.
+    // Every input column sets the initial value of the register with the same name.
+    // The output file gets a column with the final value of every output register and the "#failed" column, which is 1 for runs which threw an error.
+    // Reductions (see Reduction) aggregate the final registers of all runs which did not fail, their results are printed to `out`.
+
+    const ColumnFile input(inputPath);
+
+    std::vector<std::pair<const int32_t*, int>> inputs{};
+    for (size_t i = 0; i < input.getNames().size(); ++i) {
+        int slot = bytecode->findRegister(input.getNames()[i]);
+        if (slot < 0) throw "ERROR::BATCH::UNKNOWN_REGISTER: " + input.getNames()[i];
+        inputs.push_back({input.column(i), slot});
+    }
+    std::vector<int> outputSlots{};
+    for (const std::string& name : outputRegisters) {
+        int slot = bytecode->findRegister(name);
+        if (slot < 0) throw "ERROR::BATCH::UNKNOWN_REGISTER: " + name;
+        outputSlots.push_back(slot);
+    }
+
+    // threads start from the empty `reductions` and merge their results into `totals`
+    std::vector<Reduction> reductions{};
+    for (const std::string& spec : reductionSpecs) reductions.push_back(Reduction(spec, *bytecode));
+    std::vector<Reduction> totals = reductions;
+
+    std::vector<std::string> outputNames = outputRegisters;
+    outputNames.push_back("#failed");
+    ColumnFile output(outputPath, outputNames, input.getRowCount());
+
+    const uint64_t rowCount = input.getRowCount();
+    const uint64_t chunkSize = 4096;
+    std::atomic<uint64_t> nextRow{0};
+    std::atomic<uint64_t> failedRuns{0};
+    std::mutex mutex;
+    std::string firstError = "";
+
+    auto runThread = [&]() -> void {
+        BytecodeEngine engine(bytecode);
+        std::vector<int32_t*> columns{};
+        for (size_t i = 0; i < outputNames.size(); ++i) columns.push_back(output.column(i));
+        int32_t* failed = columns.back();
+        uint64_t failedHere = 0;
+        std::vector<Reduction> partials = reductions;
+
+        while (true) {
+            uint64_t start = nextRow.fetch_add(chunkSize);
+            if (start >= rowCount) break;
+            uint64_t end = std::min(start + chunkSize, rowCount);
+
+            for (uint64_t row = start; row < end; ++row) {
+                engine.reset();
+                for (const auto& in : inputs) engine.setRegister(in.second, in.first[row]);
+                try {
+                    engine.run(false);
+                    for (size_t i = 0; i < outputSlots.size(); ++i) columns[i][row] = engine.getRegister(outputSlots[i]);
+                    for (Reduction& r : partials) r.add(engine);
+                } catch (const std::string& e) {
+                    failed[row] = 1;
+                    if (failedHere++ == 0) {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        if (firstError.empty()) firstError = e;
+                    }
+                }
+            }
+        }
+        failedRuns += failedHere;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        for (size_t i = 0; i < partials.size(); ++i) totals[i].merge(partials[i]);
+    };
+
+    auto startTime = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads{};
+    for (size_t i = 0; i < std::max<size_t>(threadCount, 1); ++i) threads.emplace_back(runThread);
+    for (std::thread& t : threads) t.join();
+    for (const Reduction& r : totals) r.print(out);
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    std::cerr << rowCount << " runs, " << failedRuns << " failed, " << seconds << " s\n";
+    if (failedRuns > 0) std::cerr << "First error: " << firstError << '\n';
+}
+
+#ifdef __linux__
+// daemon mode
+//
+// The server accepts programs over a local (unix domain) socket. A single thread runs an epoll event loop which handles all connections,
+// programs are compiled (using the program cache) and executed by the worker pool. A client may send many requests without waiting
+// for responses; responses are sent in the order of requests and all responses which are ready are written at once.
+//
+// Messages use the same format as the coordinator/worker mode:
+//   client -> server:    "RUN [name=value ...] <length>", the payload is the program and the optional fields are initial register values
+//                        "METRICS 0", the response contains metrics of the daemon in the Prometheus text format
+//   server -> client:    "OK <length>" (payload is the output), "ERR <length>" (payload is the error)
+
+volatile sig_atomic_t isServerStopping = 0;
+
+class Server
+{
+private:
+    // maximum size of a request, larger requests close the connection
+    static const size_t maxRequestSize = 16 * 1024 * 1024;
+    // a connection with more unfinished requests is not read until some of them are finished
+    static const size_t maxPendingRequests = 1024;
+
+    struct client {
+        int fd;
+        std::string input;
+        std::string output;
+        // responses of unfinished requests in the order of requests, empty until the request is finished
+        std::deque<std::string> responses;
+        std::deque<bool> isFinished;
+        // sequence number of the first response in `responses`
+        uint64_t firstSequence;
+        uint32_t events;
+    };
+    // a response computed by the worker pool
+    struct completion {
+        uint64_t clientId;
+        uint64_t sequence;
+        std::string response;
+    };
+
+    int epoll;
+    int listener;
+    // signals the event loop that completions are ready
+    int wakeup;
+    std::string socketPath;
+
+    ProgramCache cache;
+    // destroyed first, so running requests can still report their completion
+    std::unique_ptr<WorkerPool> pool;
+    uint64_t instructionLimit;
+
+    std::unordered_map<uint64_t, client> clients;
+    // ids of clients by their file descriptors
+    std::unordered_map<int, uint64_t> clientIds;
+    uint64_t nextClientId;
+
+    std::mutex completionMutex;
+    std::vector<completion> completions;
+
+    void acceptClients();
+    void readClient(uint64_t id);
+    void handleRequests(uint64_t id);
+    void writeClient(uint64_t id);
+    void updateEvents(client& c);
+    void closeClient(uint64_t id);
+    void finishRequests();
+
+    std::string runRequest(const std::string& header, const std::string& program);
+public:
+    Server(const std::string& socketPath, size_t threadCount, uint64_t instructionLimit);
+    ~Server();
+
+    // runs until SIGINT or SIGTERM is received
+    void run();
+};
+
+Server::Server(const std::string& socketPath, size_t threadCount, uint64_t instructionLimit)
+    : socketPath(socketPath), cache(1024), instructionLimit(instructionLimit)
+{
+    this->pool = std::unique_ptr<WorkerPool>(new WorkerPool(threadCount));
+    this->clients = {};
+    this->clientIds = {};
+    this->nextClientId = 0;
+    this->completions = {};
+
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (socketPath.length() >= sizeof(address.sun_path)) throw "ERROR::SERVER::SOCKET_PATH_TOO_LONG: " + socketPath;
+    std::strcpy(address.sun_path, socketPath.c_str());
+
+    this->epoll = epoll_create1(EPOLL_CLOEXEC);
+    this->wakeup = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    this->listener = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (this->epoll < 0 || this->wakeup < 0 || this->listener < 0) throw std::string("ERROR::SERVER::CAN_NOT_CREATE_SOCKET");
+
+    unlink(socketPath.c_str());
+    if (bind(this->listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 || listen(this->listener, SOMAXCONN) < 0) {
+        throw "ERROR::SERVER::CAN_NOT_LISTEN: " + socketPath;
+    }
+
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.fd = this->listener;
+    epoll_ctl(this->epoll, EPOLL_CTL_ADD, this->listener, &event);
+    event.data.fd = this->wakeup;
+    epoll_ctl(this->epoll, EPOLL_CTL_ADD, this->wakeup, &event);
+}
+
+Server::~Server()
+{
+    this->pool.reset();
+    for (auto& c : this->clients) close(c.second.fd);
+    close(this->listener);
+    close(this->wakeup);
+    close(this->epoll);
+    unlink(this->socketPath.c_str());
+}
+
+void Server::run()
+{
+    std::vector<epoll_event> events(256);
+
+    while (!isServerStopping) {
+        int count = epoll_wait(this->epoll, events.data(), static_cast<int>(events.size()), -1);
+        if (count < 0) continue;
+
+        for (int i = 0; i < count; ++i) {
+            int fd = events[i].data.fd;
+            if (fd == this->listener) {
+                this->acceptClients();
+            } else if (fd == this->wakeup) {
+                this->finishRequests();
+            } else {
+                auto it = this->clientIds.find(fd);
+                if (it == this->clientIds.end()) continue;
+                uint64_t id = it->second;
+                if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) this->readClient(id);
+                if (this->clients.count(id) && (events[i].events & EPOLLOUT)) this->writeClient(id);
+            }
+        }
+    }
+}
+
+void Server::acceptClients()
+{
+    while (true) {
+        int fd = accept4(this->listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) return;
+
+        uint64_t id = this->nextClientId++;
+        this->clients[id] = client{fd, "", "", {}, {}, 0, 0};
+        this->clientIds[fd] = id;
+
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.fd = fd;
+        epoll_ctl(this->epoll, EPOLL_CTL_ADD, fd, &event);
+        this->clients[id].events = EPOLLIN;
+    }
+}
+
+void Server::readClient(uint64_t id)
+{
+    client& c = this->clients[id];
+    char data[65536];
+
+    while (true) {
+        ssize_t received = recv(c.fd, data, sizeof(data), 0);
+        if (received > 0) {
+            c.input.append(data, static_cast<size_t>(received));
+            if (c.input.length() > Server::maxRequestSize + 4096) break;
+            continue;
+        }
+        if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        if (received < 0 && errno == EINTR) continue;
+        // closed by the client, unfinished requests are dropped
+        this->closeClient(id);
+        return;
+    }
+
+    this->handleRequests(id);
+}
+
+void Server::handleRequests(uint64_t id)
+{
+    client& c = this->clients[id];
+    std::string header = "";
+    std::string program = "";
+
+    try {
+        while (c.responses.size() < Server::maxPendingRequests && extractMessage(c.input, header, program)) {
+            uint64_t sequence = c.firstSequence + c.responses.size();
+            c.responses.push_back("");
+            c.isFinished.push_back(false);
+
+            auto received = std::chrono::steady_clock::now();
+            this->pool->submit([this, id, sequence, header, program, received]() {
+                std::string response = this->runRequest(header, program);
+                if (isMetricsEnabled) {
+                    auto duration = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - received);
+                    metrics.requestLatency.record(static_cast<uint64_t>(duration.count()));
+                }
+                {
+                    std::lock_guard<std::mutex> lock(this->completionMutex);
+                    this->completions.push_back({id, sequence, std::move(response)});
+                }
+                uint64_t one = 1;
+                ssize_t written = write(this->wakeup, &one, sizeof(one));
+                (void)written;
+            });
+        }
+    } catch (const std::string&) {
+        this->closeClient(id);
+        return;
+    }
+
+    // the header of the next request does not declare a reasonable length
+    if (c.input.length() > Server::maxRequestSize + 4096) {
+        this->closeClient(id);
+        return;
+    }
+    this->updateEvents(c);
+}
+
+std::string Server::runRequest(const std::string& header, const std::string& program)
+{
+    auto respond = [](const std::string& status, const std::string& payload) -> std::string {
+        return status + " " + std::to_string(payload.length()) + "\n" + payload;
+    };
+
+    try {
+        std::stringstream ss(header);
+        std::string command = "";
+        ss >> command;
+        if (command == "METRICS") {
+            std::ostringstream out;
+            metrics.write(out);
+            return respond("OK", out.str());
+        }
+        if (command != "RUN") return respond("ERR", "ERROR::SERVER::UNKNOWN_COMMAND: " + command);
+        if (program.length() > Server::maxRequestSize) return respond("ERR", std::string("ERROR::SERVER::REQUEST_TOO_LARGE"));
+
+        std::string inputs = "";
+        std::getline(ss, inputs);
+
+        std::shared_ptr<const Bytecode> bytecode = this->cache.get(program);
+        BytecodeEngine engine(bytecode);
+        engine.setInstructionLimit(this->instructionLimit);
+        for (const auto& reg : parseRegisterValues(inputs)) {
+            int slot = bytecode->findRegister(reg.first);
+            if (slot >= 0) engine.setRegister(slot, reg.second);
+        }
+        engine.run();
+        return respond("OK", engine.getOutput());
+    } catch (const std::string& e) {
+        return respond("ERR", e);
+    } catch (const std::exception& e) {
+        return respond("ERR", std::string("ERROR::SERVER::EXCEPTION: ") + e.what());
+    }
+}
+
+void Server::finishRequests()
+{
+    uint64_t counter = 0;
+    ssize_t received = read(this->wakeup, &counter, sizeof(counter));
+    (void)received;
+
+    std::vector<completion> finished{};
+    {
+        std::lock_guard<std::mutex> lock(this->completionMutex);
+        finished.swap(this->completions);
+    }
+
+    std::vector<uint64_t> updated{};
+    for (completion& f : finished) {
+        auto it = this->clients.find(f.clientId);
+        if (it == this->clients.end()) continue;
+        client& c = it->second;
+        size_t index = static_cast<size_t>(f.sequence - c.firstSequence);
+        c.responses[index] = std::move(f.response);
+        c.isFinished[index] = true;
+        updated.push_back(f.clientId);
+    }
+
+    std::sort(updated.begin(), updated.end());
+    updated.erase(std::unique(updated.begin(), updated.end()), updated.end());
+    for (uint64_t id : updated) {
+        client& c = this->clients[id];
+        // responses are sent in the order of requests
+        while (!c.isFinished.empty() && c.isFinished.front()) {
+            c.output += c.responses.front();
+            c.responses.pop_front();
+            c.isFinished.pop_front();
+            c.firstSequence++;
+        }
+        this->writeClient(id);
+        // requests which were waiting for free space
+        if (this->clients.count(id)) this->handleRequests(id);
+    }
+}
+
+void Server::writeClient(uint64_t id)
+{
+    client& c = this->clients[id];
+    while (!c.output.empty()) {
+        ssize_t sent = send(c.fd, c.output.data(), c.output.length(), MSG_NOSIGNAL);
+        if (sent > 0) {
+            c.output.erase(0, static_cast<size_t>(sent));
+            continue;
+        }
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        if (sent < 0 && errno == EINTR) continue;
+        this->closeClient(id);
+        return;
+    }
+    this->updateEvents(c);
+}
+
+void Server::updateEvents(client& c)
+{
+    uint32_t events = (c.responses.size() < Server::maxPendingRequests ? static_cast<uint32_t>(EPOLLIN) : 0u) | (c.output.empty() ? 0u : static_cast<uint32_t>(EPOLLOUT));
+    if (events == c.events) return;
+
+    epoll_event event{};
+    event.events = events;
+    event.data.fd = c.fd;
+    epoll_ctl(this->epoll, EPOLL_CTL_MOD, c.fd, &event);
+    c.events = events;
+}
+
+void Server::closeClient(uint64_t id)
+{
+    auto it = this->clients.find(id);
+    if (it == this->clients.end()) return;
+    epoll_ctl(this->epoll, EPOLL_CTL_DEL, it->second.fd, nullptr);
+    close(it->second.fd);
+    this->clientIds.erase(it->second.fd);
+    this->clients.erase(it);
+}
+
+// sends requests which must not stop the daemon to a running daemon, each over its own connection, and prints their results
+// the last request is a plain program, so a daemon which died on one of the requests before fails it too
+// returns the number of failed checks
+size_t checkDaemon(const std::string& socketPath, std::ostream& out)
+{
+    struct check {
+        std::string name;
+        std::string program;
+        // the response must have the status and its payload must start with the prefix
+        std::string status;
+        std::string prefix;
+    };
+    const std::vector<check> checks{
+        {"smallest int / -1", "mov a, 1\nshl a, 31\ndiv a, -1\nmsg a\nend", "OK", "-2147483648"},
+        {"smallest int % -1", "mov a, 1\nshl a, 31\nmod a, -1\nmsg a\nend", "OK", "0"},
+        {"division by zero", "mov a, 1\ndiv a, 0\nend", "ERR", "ERROR::INTERPRETER::DIVISION_BY_ZERO"},
+        // fail on the instruction limit or, for recursion, on the call depth
+        {"endless loop", "l:\njmp l", "ERR", "ERROR::INTERPRETER::"},
+        {"unbounded recursion", "f:\ncall f", "ERR", "ERROR::INTERPRETER::"},
+        {"plain program", "mov a, 5\nmsg 'a = ', a\nend", "OK", "a = 5"},
+    };
+
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (socketPath.length() >= sizeof(address.sun_path)) throw "ERROR::SERVER::SOCKET_PATH_TOO_LONG: " + socketPath;
+    std::strcpy(address.sun_path, socketPath.c_str());
+
+    size_t failed = 0;
+    for (const check& c : checks) {
+        std::string result = "no response";
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd >= 0 && connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == 0) {
+            // a daemon without an instruction limit never answers the endless loop
+            timeval timeout{30, 0};
+            setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+            Connection connection(fd);
+            std::string header = "";
+            std::string payload = "";
+            if (connection.sendMessage("RUN", c.program) && connection.readMessage(header, payload)) {
+                std::string status = header.substr(0, header.find(' '));
+                result = status + " " + payload;
+                if (status == c.status && payload.compare(0, c.prefix.length(), c.prefix) == 0) result = "";
+            }
+        } else {
+            if (fd >= 0) close(fd);
+            result = "can not connect";
+        }
+        if (!result.empty()) ++failed;
+        out << (result.empty() ? "ok\t" : "FAILED\t") << c.name << (result.empty() ? "" : ": " + result) << '\n';
+    }
+    return failed;
+}
+#endif
+
+#ifndef _WIN32
+// sampling profiler
+//
+// While the profiler is running, a SIGPROF timer interrupts the process periodically. The signal handler copies the execution probe
+// of the interrupted thread into a preallocated buffer, the samples are aggregated once the profiler is stopped.
+// Only one profiler can run at a time.
+
+class SamplingProfiler
+{
+private:
+    struct sample {
+        uint32_t position;
+        uint32_t depth;
+        uint32_t frames[ExecutionProbe::maxDepth];
+    };
+    static constexpr size_t capacity = 65536;
+
+    // written by the signal handler
+    static sample samples[capacity];
+    static std::atomic<size_t> sampleCount;
+    // samples of threads which were not running a program
+    static std::atomic<size_t> idleSamples;
+
+    struct sigaction previousAction;
+    bool isRunning;
+
+    static void handleSignal(int);
+
+    // returns the name of the label containing the position, the instructions before the first label belong to "<main>"
+    static std::string findLabel(const std::vector<std::pair<size_t, std::string>>& labels, uint32_t position);
+public:
+    SamplingProfiler();
+    ~SamplingProfiler();
+
+    void start(int frequency);
+    void stop();
+
+    // prints the number of samples of every label, the labels with most samples first
+    void printLabels(const std::unordered_map<std::string, size_t>& labels, std::ostream& out) const;
+    // prints the number of samples of every call stack in the folded format used by flame graph tools: "<main>;caller;callee 42"
+    // a stack consists of the called labels; when the program is not at the called label, the label containing its position is the last frame
+    void printFoldedStacks(const std::unordered_map<std::string, size_t>& labels, std::ostream& out) const;
+};
+
+SamplingProfiler::sample SamplingProfiler::samples[SamplingProfiler::capacity];
+std::atomic<size_t> SamplingProfiler::sampleCount{0};
+std::atomic<size_t> SamplingProfiler::idleSamples{0};
+
+SamplingProfiler::SamplingProfiler()
+{
+    this->previousAction = {};
+    this->isRunning = false;
+}
+
+SamplingProfiler::~SamplingProfiler()
+{
+    this->stop();
+}
+
+void SamplingProfiler::handleSignal(int)
+{
+    uint32_t position = executionProbe.position.load(std::memory_order_relaxed);
+    if (position == 0) {
+        idleSamples.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    size_t index = sampleCount.fetch_add(1, std::memory_order_relaxed);
+    if (index >= SamplingProfiler::capacity) return;
+
+    sample& s = samples[index];
+    s.position = position - 1;
+    s.depth = executionProbe.depth.load(std::memory_order_relaxed);
+    std::atomic_signal_fence(std::memory_order_acquire);
+    for (uint32_t i = 0; i < std::min(s.depth, ExecutionProbe::maxDepth); ++i) s.frames[i] = executionProbe.frames[i].load(std::memory_order_relaxed);
+}
+
+void SamplingProfiler::start(int frequency)
+{
+    if (this->isRunning) return;
+    if (frequency <= 0 || frequency > 100000) throw "ERROR::PROFILER::INVALID_FREQUENCY: " + std::to_string(frequency);
+
+    sampleCount = 0;
+    idleSamples = 0;
+
+    struct sigaction action{};
+    action.sa_handler = &SamplingProfiler::handleSignal;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGPROF, &action, &this->previousAction);
+
+    isProbeEnabled = true;
+
+    itimerval timer{};
+    timer.it_interval.tv_sec = 0;
+    timer.it_interval.tv_usec = 1000000 / frequency;
+    timer.it_value = timer.it_interval;
+    setitimer(ITIMER_PROF, &timer, nullptr);
+
+    this->isRunning = true;
+}
+
+void SamplingProfiler::stop()
+{
+    if (!this->isRunning) return;
+
+    itimerval timer{};
+    setitimer(ITIMER_PROF, &timer, nullptr);
+    isProbeEnabled = false;
+    sigaction(SIGPROF, &this->previousAction, nullptr);
+
+    this->isRunning = false;
+}
+
+std::string SamplingProfiler::findLabel(const std::vector<std::pair<size_t, std::string>>& labels, uint32_t position)
+{
+    // labels are sorted by position, the last label at or before the position contains it
+    auto it = std::upper_bound(labels.begin(), labels.end(), std::make_pair(static_cast<size_t>(position), std::string(1, '\x7f')));
+    return it == labels.begin() ? "<main>" : std::prev(it)->second;
+}
+
+void SamplingProfiler::printLabels(const std::unordered_map<std::string, size_t>& labels, std::ostream& out) const
+{
+    std::vector<std::pair<size_t, std::string>> sortedLabels{};
+    for (const auto& label : labels) sortedLabels.push_back({label.second, label.first});
+    std::sort(sortedLabels.begin(), sortedLabels.end());
+
+    size_t count = std::min(sampleCount.load(), SamplingProfiler::capacity);
+    std::unordered_map<std::string, size_t> counts{};
+    for (size_t i = 0; i < count; ++i) counts[findLabel(sortedLabels, samples[i].position)]++;
+
+    std::vector<std::pair<size_t, std::string>> sortedCounts{};
+    for (const auto& c : counts) sortedCounts.push_back({c.second, c.first});
+    std::sort(sortedCounts.begin(), sortedCounts.end(), [](const std::pair<size_t, std::string>& a, const std::pair<size_t, std::string>& b) {
+        return a.first != b.first ? a.first > b.first : a.second < b.second;
+    });
+
+    out << count << " samples (" << idleSamples.load() << " idle, " << (sampleCount.load() - count) << " dropped)\n";
+    out << "SAMPLES\tPERCENT\tLABEL\n";
+    for (const auto& c : sortedCounts) {
+        out << c.first << '\t' << (100.0 * static_cast<double>(c.first) / static_cast<double>(count)) << "%\t" << c.second << '\n';
+    }
+}
+
+void SamplingProfiler::printFoldedStacks(const std::unordered_map<std::string, size_t>& labels, std::ostream& out) const
+{
+    std::vector<std::pair<size_t, std::string>> sortedLabels{};
+    for (const auto& label : labels) sortedLabels.push_back({label.second, label.first});
+    std::sort(sortedLabels.begin(), sortedLabels.end());
+
+    size_t count = std::min(sampleCount.load(), SamplingProfiler::capacity);
+    std::map<std::string, size_t> stacks{};
+    for (size_t i = 0; i < count; ++i) {
+        const sample& s = samples[i];
+        std::string stack = "<main>";
+        std::string frame = "<main>";
+        for (uint32_t d = 0; d < std::min(s.depth, ExecutionProbe::maxDepth); ++d) {
+            frame = findLabel(sortedLabels, s.frames[d]);
+            stack += ";" + frame;
+        }
+        if (s.depth > ExecutionProbe::maxDepth) {
+            stack += ";[truncated]";
+            frame = "";
+        }
+        std::string leaf = findLabel(sortedLabels, s.position);
+        if (leaf != frame) stack += ";" + leaf;
+        stacks[stack]++;
+    }
+
+    for (const auto& stack : stacks) out << stack.first << ' ' << stack.second << '\n';
+}
+#endif
+
+void profileProgram(const std::string& program, const std::vector<std::pair<std::string, int>>& inputs, double seconds, int frequency, bool isFolded, std::ostream& out)
+{
+    // This function runs a compiled program repeatedly for the given time while the sampling profiler is running.
+
+    std::shared_ptr<const Bytecode> bytecode = std::make_shared<const Bytecode>(Interpreter::compile(program));
+    BytecodeEngine engine(bytecode);
+
+#ifndef _WIN32
+    SamplingProfiler profiler{};
+    profiler.start(frequency);
+#else
+    (void)frequency;
+    throw std::string("ERROR::PROFILER::NOT_SUPPORTED");
+#endif
+
+    auto startTime = std::chrono::steady_clock::now();
+    uint64_t runs = 0;
+    uint64_t instructions = 0;
+    double elapsed = 0;
+    while (elapsed < seconds) {
+        engine.reset();
+        for (const auto& reg : inputs) {
+            int slot = bytecode->findRegister(reg.first);
+            if (slot >= 0) engine.setRegister(slot, reg.second);
+        }
+        engine.run(false);
+        runs++;
+        instructions += engine.getExecutedInstructions();
+        elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    }
+
+#ifndef _WIN32
+    profiler.stop();
+    if (isFolded) {
+        profiler.printFoldedStacks(bytecode->labels, out);
+    } else {
+        out << runs << " runs, " << (static_cast<double>(instructions) / elapsed) << " instructions/s\n";
+        profiler.printLabels(bytecode->labels, out);
+    }
+#endif
+}
+
+void benchProgram(const std::string& program, size_t runs, std::ostream& out)
+{
+    // This function compiles and runs a program the given number of times and prints statistics of both phases.
+
+    runs = std::max<size_t>(runs, 1);
+    std::vector<double> parseTimes{};
+    std::vector<double> executeTimes{};
+    uint64_t instructions = 0;
+    std::shared_ptr<const Bytecode> bytecode = nullptr;
+
+    for (size_t i = 0; i < runs; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        bytecode = std::make_shared<const Bytecode>(Interpreter::compile(program));
+        parseTimes.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+
+        BytecodeEngine engine(bytecode);
+        start = std::chrono::steady_clock::now();
+        engine.run();
+        executeTimes.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        instructions += engine.getExecutedInstructions();
+    }
+
+    auto print = [&out](const std::string& phase, std::vector<double>& times) -> void {
+        std::sort(times.begin(), times.end());
+        auto percentile = [&times](double fraction) -> double {
+            return times[std::min(times.size() - 1, static_cast<size_t>(fraction * static_cast<double>(times.size())))] * 1e6;
+        };
+        out << phase << "\tmin " << times.front() * 1e6 << " us\tmedian " << percentile(0.5) << " us\tp99 " << percentile(0.99) << " us\n";
+    };
+
+    double executeTime = 0;
+    for (double time : executeTimes) executeTime += time;
+
+    out << runs << " runs, " << (instructions / runs) << " instructions per run\n";
+    print("parse", parseTimes);
+    print("execute", executeTimes);
+    out << (executeTime > 0 ? static_cast<double>(instructions) / executeTime : 0) << " instructions/s\n";
+}
+
+// control flow traces
+// reads files written by TraceRecorder
+class TraceReader
+{
+private:
+    std::string data;
+    size_t position;
+    std::shared_ptr<const Bytecode> bytecode;
+public:
+    struct run {
+        // pairs of register slot and initial value
+        std::vector<std::pair<int, int>> inputs;
+        // raw events of TraceRecorder
+        std::vector<uint32_t> events;
+        bool isFailed;
+        uint64_t instructions;
+        std::vector<int> registers;
+        // output or error
+        std::string output;
+    };
+
+    explicit TraceReader(const std::string& path);
+
+    std::shared_ptr<const Bytecode> getBytecode() const;
+    // returns false at the end of the file
+    bool next(TraceReader::run& r);
+};
+
+TraceReader::TraceReader(const std::string& path)
+{
+    const std::string magic = "ASMTRACE1\n";
+
+    this->data = readFile(path);
+    if (this->data.compare(0, magic.size(), magic) != 0) throw "ERROR::TRACE::INVALID_FORMAT: " + path;
+    this->position = magic.size();
+
+    uint64_t length = readVarint(this->data, this->position);
+    if (length > this->data.size() - this->position) throw std::string("ERROR::TRACE::INVALID_FORMAT: unexpected end of file");
+    this->bytecode = std::make_shared<const Bytecode>(Bytecode::deserialize(this->data.substr(this->position, length)));
+    this->position += length;
+}
+
+std::shared_ptr<const Bytecode> TraceReader::getBytecode() const
+{
+    return this->bytecode;
+}
+
+bool TraceReader::next(TraceReader::run& r)
+{
+    if (this->position >= this->data.size()) return false;
+    if (static_cast<uint8_t>(this->data[this->position++]) != 0x81) throw std::string("ERROR::TRACE::INVALID_FORMAT: expected start of a run");
+
+    auto readInt = [this]() -> int {
+        return static_cast<int>(unzigzag(readVarint(this->data, this->position)));
+    };
+
+    r.inputs.clear();
+    r.events.clear();
+    r.registers.clear();
+    uint64_t count = readVarint(this->data, this->position);
+    for (uint64_t i = 0; i < count; ++i) {
+        int slot = static_cast<int>(readVarint(this->data, this->position));
+        if (slot < 0 || static_cast<size_t>(slot) >= this->bytecode->registerNames.size()) throw std::string("ERROR::TRACE::INVALID_FORMAT: register slot");
+        r.inputs.push_back({slot, readInt()});
+    }
+
+    int64_t lastTarget = 0;
+    while (true) {
+        if (this->position >= this->data.size()) throw std::string("ERROR::TRACE::INVALID_FORMAT: unexpected end of file");
+        uint8_t packet = static_cast<uint8_t>(this->data[this->position++]);
+
+        if (packet < 0x80) {
+            if (packet < 2) throw std::string("ERROR::TRACE::INVALID_FORMAT: empty branch packet");
+            int bits = 6;
+            while (!(packet & (1u << bits))) --bits;
+            for (int bit = bits - 1; bit >= 0; --bit) r.events.push_back((packet >> bit) & 1u);
+        } else if (packet == 0x80) {
+            lastTarget += unzigzag(readVarint(this->data, this->position));
+            if (lastTarget < 0 || static_cast<size_t>(lastTarget) > this->bytecode->code.size()) throw std::string("ERROR::TRACE::INVALID_FORMAT: target position");
+            r.events.push_back(TraceRecorder::targetEvent | static_cast<uint32_t>(lastTarget));
+        } else if (packet == 0x82) {
+            r.isFailed = readVarint(this->data, this->position) != 0;
+            r.instructions = readVarint(this->data, this->position);
+            count = readVarint(this->data, this->position);
+            if (count != this->bytecode->registerNames.size()) throw std::string("ERROR::TRACE::INVALID_FORMAT: register count");
+            for (uint64_t i = 0; i < count; ++i) r.registers.push_back(readInt());
+            uint64_t length = readVarint(this->data, this->position);
+            if (length > this->data.size() - this->position) throw std::string("ERROR::TRACE::INVALID_FORMAT: unexpected end of file");
+            r.output = this->data.substr(this->position, length);
+            this->position += length;
+            return true;
+        } else {
+            throw "ERROR::TRACE::INVALID_FORMAT: unknown packet " + std::to_string(packet);
+        }
+    }
+}
+
+void recordTrace(const std::string& program, const std::vector<std::vector<std::pair<std::string, int>>>& jobs, const std::string& path, std::ostream& out)
+{
+    // This function runs every job of a program and records its control flow and final state into a trace file.
+
+    std::shared_ptr<const Bytecode> bytecode = std::make_shared<const Bytecode>(Interpreter::compile(program));
+    BytecodeEngine engine(bytecode);
+    TraceRecorder recorder(path, *bytecode);
+    engine.setRecorder(&recorder);
+
+    std::vector<int> registers(bytecode->registerNames.size(), 0);
+    uint64_t instructions = 0;
+    size_t failed = 0;
+    for (const auto& job : jobs) {
+        std::vector<std::pair<int, int>> inputs{};
+        engine.reset();
+        for (const auto& reg : job) {
+            int slot = bytecode->findRegister(reg.first);
+            if (slot < 0) continue;
+            engine.setRegister(slot, reg.second);
+            inputs.push_back({slot, reg.second});
+        }
+
+        recorder.beginRun(inputs);
+        bool isFailed = false;
+        std::string output = "";
+        try {
+            engine.run();
+            output = engine.getOutput();
+        } catch (const std::string& e) {
+            isFailed = true;
+            output = e;
+            failed++;
+        }
+        for (size_t slot = 0; slot < registers.size(); ++slot) registers[slot] = engine.getRegister(static_cast<int>(slot));
+        recorder.endRun(isFailed, engine.getExecutedInstructions(), registers, output);
+        instructions += engine.getExecutedInstructions();
+    }
+    recorder.close();
+
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    out << jobs.size() << " runs (" << failed << " failed), " << instructions << " instructions, " << file.tellg() << " bytes\n";
+}
+
+bool replayTrace(const std::string& path, std::ostream& out)
+{
+    // This function runs the recorded runs of a trace again and compares their control flow and final state with the recorded ones.
+    // It returns false if any run diverged.
+
+    const size_t maxReported = 10;
+
+    TraceReader reader(path);
+    std::shared_ptr<const Bytecode> bytecode = reader.getBytecode();
+    BytecodeEngine engine(bytecode);
+    TraceRecorder recorder{};
+    engine.setRecorder(&recorder);
+
+    auto describe = [](uint32_t event) -> std::string {
+        if (event <= 1) return event ? "taken jump" : "jump not taken";
+        return "RET or JTAB to " + std::to_string(event & ~TraceRecorder::targetEvent);
+    };
+
+    TraceReader::run r{};
+    size_t runs = 0;
+    size_t diverged = 0;
+    while (reader.next(r)) {
+        engine.reset();
+        for (const auto& input : r.inputs) engine.setRegister(input.first, input.second);
+
+        recorder.clear();
+        bool isFailed = false;
+        std::string output = "";
+        try {
+            engine.run();
+            output = engine.getOutput();
+        } catch (const std::string& e) {
+            isFailed = true;
+            output = e;
+        }
+
+        std::string divergence = "";
+        const std::vector<uint32_t>& events = recorder.getEvents();
+        auto mismatch = std::mismatch(r.events.begin(), r.events.end(), events.begin(), events.end());
+        if (mismatch.first != r.events.end() || mismatch.second != events.end()) {
+            size_t index = static_cast<size_t>(mismatch.first - r.events.begin());
+            divergence = "control flow diverges at event " + std::to_string(index) + ": recorded "
+                + (mismatch.first != r.events.end() ? describe(*mismatch.first) : "end of run") + ", replayed "
+                + (mismatch.second != events.end() ? describe(*mismatch.second) : "end of run");
+        } else if (isFailed != r.isFailed || output != r.output) {
+            divergence = "output differs: recorded \"" + r.output + "\", replayed \"" + output + "\"";
+        } else if (engine.getExecutedInstructions() != r.instructions) {
+            divergence = "executed instructions differ: recorded " + std::to_string(r.instructions) + ", replayed " + std::to_string(engine.getExecutedInstructions());
+        } else {
+            for (size_t slot = 0; slot < r.registers.size(); ++slot) {
+                if (engine.getRegister(static_cast<int>(slot)) == r.registers[slot]) continue;
+                divergence = "register " + bytecode->registerNames[slot] + " differs: recorded " + std::to_string(r.registers[slot])
+                    + ", replayed " + std::to_string(engine.getRegister(static_cast<int>(slot)));
+                break;
+            }
+        }
+
+        if (!divergence.empty() && diverged++ < maxReported) out << "run " << runs << ": " << divergence << '\n';
+        runs++;
+    }
+
+    out << runs << " runs replayed, " << diverged << " diverged\n";
+    return diverged == 0;
+}
+
+void profileTrace(const std::string& path, std::ostream& out)
+{
+    // This function reconstructs the executed instructions of every recorded run from the trace without running the program
+    // and prints the number of executed instructions of every label.
+
+    TraceReader reader(path);
+    std::shared_ptr<const Bytecode> bytecode = reader.getBytecode();
+    const std::vector<Bytecode::op>& code = bytecode->code;
+    std::vector<uint64_t> counts(code.size(), 0);
+
+    TraceReader::run r{};
+    size_t runs = 0;
+    uint64_t total = 0;
+    while (reader.next(r)) {
+        size_t instructionPointer = 0;
+        size_t event = 0;
+        auto nextEvent = [&]() -> uint32_t {
+            if (event >= r.events.size()) throw "ERROR::TRACE::INCONSISTENT: run " + std::to_string(runs) + " has too few events";
+            return r.events[event++];
+        };
+
+        // every executed instruction is counted, including the one which threw an error
+        for (uint64_t executed = 0; executed < r.instructions && instructionPointer < code.size(); ++executed) {
+            counts[instructionPointer]++;
+            const Bytecode::op& op = code[instructionPointer++];
+            switch (op.type)
+            {
+            case InstructionType::JMP:
+            case InstructionType::CALL:
+                if (op.target >= 0) instructionPointer = static_cast<size_t>(op.target);
+                break;
+            case InstructionType::JNE:
+            case InstructionType::JE:
+            case InstructionType::JGE:
+            case InstructionType::JG:
+            case InstructionType::JLE:
+            case InstructionType::JL:
+            case InstructionType::LOOP:
+            case InstructionType::JNZ:
+            case InstructionType::JZ:
+            case InstructionType::DECJNE: {
+                uint32_t e = nextEvent();
+                if (e > 1) throw "ERROR::TRACE::INCONSISTENT: run " + std::to_string(runs) + " expected a jump";
+                if (op.type == InstructionType::DECJNE) {
+                    // the fused CMP and JNE count as executed
+                    counts[instructionPointer]++;
+                    counts[instructionPointer + 1]++;
+                    executed += 2;
+                    if (e == 0) instructionPointer += 2;
+                }
+                if (e == 1 && op.target >= 0) instructionPointer = static_cast<size_t>(op.target);
+                break;
+            }
+            case InstructionType::CMOVNE:
+            case InstructionType::CMOVE:
+            case InstructionType::CMOVGE:
+            case InstructionType::CMOVG:
+            case InstructionType::CMOVLE:
+            case InstructionType::CMOVL: {
+                if (op.target < 0) break;
+                // a jump converted into a conditional move, the instructions of the path it takes count as executed
+                uint32_t e = nextEvent();
+                if (e > 1) throw "ERROR::TRACE::INCONSISTENT: run " + std::to_string(runs) + " expected a jump";
+                size_t end = static_cast<size_t>(op.target);
+                bool isElse = end == instructionPointer + 3;
+                if (e == 0) {
+                    for (size_t i = instructionPointer; i < (isElse ? end - 1 : end); ++i, ++executed) counts[i]++;
+                } else if (isElse) {
+                    counts[end - 1]++;
+                    executed++;
+                }
+                instructionPointer = end;
+                break;
+            }
+            case InstructionType::RET:
+            case InstructionType::JTAB: {
+                uint32_t e = nextEvent();
+                if ((e & TraceRecorder::runStartEvent) != TraceRecorder::targetEvent) throw "ERROR::TRACE::INCONSISTENT: run " + std::to_string(runs) + " expected RET or JTAB";
+                instructionPointer = e & ~TraceRecorder::targetEvent;
+                break;
+            }
+            case InstructionType::END:
+                // the rest of the instructions of the run were executed by spawned tasks, which are not recorded
+                instructionPointer = code.size();
+                break;
+            default:
+                break;
+            }
+        }
+        total += r.instructions;
+        runs++;
+    }
+
+    std::vector<std::pair<size_t, std::string>> labels{{0, "<main>"}};
+    for (const auto& label : bytecode->labels) labels.push_back({label.second, label.first});
+    std::sort(labels.begin(), labels.end());
+
+    // the instructions before the next label belong to a label
+    std::map<std::string, uint64_t> labelCounts{};
+    for (size_t i = 0; i < labels.size(); ++i) {
+        size_t end = i + 1 < labels.size() ? labels[i + 1].first : code.size();
+        for (size_t position = labels[i].first; position < end; ++position) labelCounts[labels[i].second] += counts[position];
+    }
+
+    std::vector<std::pair<uint64_t, std::string>> sortedCounts{};
+    for (const auto& c : labelCounts) if (c.second > 0) sortedCounts.push_back({c.second, c.first});
+    std::sort(sortedCounts.begin(), sortedCounts.end(), [](const std::pair<uint64_t, std::string>& a, const std::pair<uint64_t, std::string>& b) {
+        return a.first != b.first ? a.first > b.first : a.second < b.second;
+    });
+
+    out << runs << " runs, " << total << " instructions\n";
+    out << "INSTRUCTIONS\tPERCENT\tLABEL\n";
+    for (const auto& c : sortedCounts) {
+        out << c.first << '\t' << (100.0 * static_cast<double>(c.first) / static_cast<double>(total)) << "%\t" << c.second << '\n';
+    }
+}
+
+// microbenchmarks
+// measures the cost of single instructions on every engine
+// a benchmark runs a loop whose body repeats the measured instruction, the time of the same loop with an empty body is subtracted
+class Microbenchmark
+{
+private:
+    struct benchmark {
+        std::string name;
+        // code of a single copy and of the subroutine it calls (placed after END), "#" is replaced with the number of the copy
+        std::string body;
+        std::string subroutine;
+        // executed instructions per copy
+        size_t instructions;
+        // the copies are replaced with ops which do nothing after linking, so only fetching and dispatching is measured
+        bool isDispatchOnly;
+    };
+    struct engine {
+        std::string name;
+        // returns the time of a single run of the program in seconds, or a negative number if the engine can not run the benchmark
+        std::function<double(const std::string& program, bool isDispatchOnly)> run;
+    };
+
+    static const size_t copies = 16;
+
+    std::vector<benchmark> benchmarks;
+    std::vector<engine> engines;
+    double seconds;
+    size_t repeats;
+
+    static std::string createProgram(const benchmark& b, size_t copyCount, uint64_t iterations);
+    // returns the shortest time of the repeated runs, which is the least disturbed by other work of the machine
+    double measure(const engine& e, const benchmark& b, size_t copyCount, uint64_t iterations) const;
+public:
+    // `seconds` is the approximate time of a single measurement
+    Microbenchmark(double seconds, size_t repeats, const std::string& filter);
+
+    // prints nanoseconds per executed instruction of every benchmark and engine
+    void run(std::ostream& out);
+};
+
+Microbenchmark::Microbenchmark(double seconds, size_t repeats, const std::string& filter)
+{
+    this->seconds = seconds;
+    this->repeats = std::max<size_t>(repeats, 1);
+
+    std::vector<benchmark> all{
+        {"dispatch", "inc a", "", 1, true},
+        {"mov reg", "mov a, b", "", 1, false},
+        {"mov imm", "mov a, 1", "", 1, false},
+        {"inc", "inc a", "", 1, false},
+        {"dec", "dec a", "", 1, false},
+        {"add reg", "add a, b", "", 1, false},
+        {"add imm", "add a, 1", "", 1, false},
+        {"sub reg", "sub a, b", "", 1, false},
+        {"sub imm", "sub a, 1", "", 1, false},
+        {"mul reg", "mul a, b", "", 1, false},
+        {"mul imm", "mul a, 1", "", 1, false},
+        {"div reg", "div a, b", "", 1, false},
+        {"div imm", "div a, 1", "", 1, false},
+        {"and reg", "and a, b", "", 1, false},
+        {"and imm", "and a, 1", "", 1, false},
+        {"or reg", "or a, b", "", 1, false},
+        {"or imm", "or a, 1", "", 1, false},
+        {"xor reg", "xor a, b", "", 1, false},
+        {"xor imm", "xor a, 1", "", 1, false},
+        {"not", "not a", "", 1, false},
+        {"shl reg", "shl a, b", "", 1, false},
+        {"shl imm", "shl a, 1", "", 1, false},
+        {"shr reg", "shr a, b", "", 1, false},
+        {"shr imm", "shr a, 1", "", 1, false},
+        {"mod reg", "mod a, b", "", 1, false},
+        {"mod imm", "mod a, 1", "", 1, false},
+        {"cmp reg", "cmp a, b", "", 1, false},
+        {"cmp imm", "cmp a, 1", "", 1, false},
+        {"jmp", "jmp j#\nj#:", "", 1, false},
+        // the loop leaves a positive result of CMP, so these are taken ...
+        {"jne taken", "jne j#\nj#:", "", 1, false},
+        {"jg taken", "jg j#\nj#:", "", 1, false},
+        {"jge taken", "jge j#\nj#:", "", 1, false},
+        // ... and these are not
+        {"je not taken", "je j#\nj#:", "", 1, false},
+        {"jl not taken", "jl j#\nj#:", "", 1, false},
+        {"jle not taken", "jle j#\nj#:", "", 1, false},
+        {"jnz taken", "jnz n, j#\nj#:", "", 1, false},
+        {"jz not taken", "jz n, j#\nj#:", "", 1, false},
+        {"loop taken", "loop b, j#\nj#:", "", 1, false},
+        {"cmovg moved", "cmovg a, 7", "", 1, false},
+        {"jtab", "jtab b, j#, j#\nj#:", "", 1, false},
+        {"jtab out of range", "jtab a, j#\nj#:", "", 1, false},
+        {"load", "load c, b", "", 1, false},
+        {"load indexed", "load c, 8, b", "", 1, false},
+        {"store", "store b, a", "", 1, false},
+        {"memset 64", "memset 0, a, 64", "", 1, false},
+        {"memcpy 64", "memcpy 64, 0, 64", "", 1, false},
+        {"push + pop", "push a\npop a", "", 2, false},
+        {"push + pop 3", "push a, b, c\npop a, b, c", "", 2, false},
+        {"vadd", "vadd v0, v1", "", 1, false},
+        {"vcmpgt", "vcmpgt v0, v1", "", 1, false},
+        {"vhsum", "vhsum a, v0", "", 1, false},
+        {"vload + vstore", "vload v0, 0\nvstore 8, v0", "", 2, false},
+        {"syscall abs", "syscall b, abs, a", "", 1, false},
+        {"syscall gcd", "syscall b, gcd, a, 91", "", 1, false},
+        {"syscall hash 4", "syscall b, hash, a, b, 1, 2", "", 1, false},
+        // every copy has its own channel, the directive is placed after END
+        {"send + recv", "send #, a\nrecv a, #", ".channel 1", 2, false},
+        // the task runs END
+        {"spawn + join", "spawn t, t#\njoin t", "t#:\nend", 3, false},
+        {"cmovl not moved", "cmovl a, b", "", 1, false},
+        {"call + ret", "call f#", "f#:\nret", 2, false},
+        {"msg", "msg 'a = ', a", "", 1, false},
+    };
+    for (const benchmark& b : all) if (b.name.find(filter) != std::string::npos) this->benchmarks.push_back(b);
+
+    this->engines.push_back({"reference", [](const std::string& program, bool isDispatchOnly) -> double {
+        // the reference interpreter has no instruction which does nothing
+        if (isDispatchOnly) return -1;
+        auto start = std::chrono::steady_clock::now();
+        Interpreter interpreter(program);
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }});
+    for (bool isOptimized : {false, true}) {
+        this->engines.push_back({isOptimized ? "optimized" : "bytecode", [isOptimized](const std::string& program, bool isDispatchOnly) -> double {
+            Bytecode bytecode = Interpreter::compile(program, isOptimized);
+            if (isDispatchOnly) {
+                for (Bytecode::op& op : bytecode.code) if (op.type == InstructionType::INC) op = {InstructionType::NONE, {false, 0}, {false, 0}, {false, 0}, -1, -1};
+            }
+            BytecodeEngine engine(std::make_shared<const Bytecode>(std::move(bytecode)));
+            auto start = std::chrono::steady_clock::now();
+            engine.run(false);
+            return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }});
+    }
+}
+
+std::string Microbenchmark::createProgram(const benchmark& b, size_t copyCount, uint64_t iterations)
+{
+    auto expand = [](const std::string& code, size_t copy) -> std::string {
+        std::string result = "";
+        for (char c : code) result += c == '#' ? std::to_string(copy) : std::string(1, c);
+        return result + "\n";
+    };
+
+    std::string program = ".memory 128\nmov n, " + std::to_string(iterations) + "\nmov a, 7\nmov b, 1\nloop:\n";
+    for (size_t i = 0; i < copyCount; ++i) program += expand(b.body, i);
+    program += "dec n\ncmp n, 0\njne loop\nend\n";
+    for (size_t i = 0; i < copyCount && !b.subroutine.empty(); ++i) program += expand(b.subroutine, i);
+    return program;
+}
+
+double Microbenchmark::measure(const engine& e, const benchmark& b, size_t copyCount, uint64_t iterations) const
+{
+    std::string program = createProgram(b, copyCount, iterations);
+    double time = e.run(program, b.isDispatchOnly);
+    for (size_t i = 1; i < this->repeats; ++i) time = std::min(time, e.run(program, b.isDispatchOnly));
+    return time;
+}
+
+void Microbenchmark::run(std::ostream& out)
+{
+    // registers of the benchmarks stay far from overflowing below this number of executed copies
+    const uint64_t maxCopies = 1ull << 30;
+
+    auto pad = [](const std::string& str, size_t width) -> std::string {
+        return str.size() >= width ? str + " " : str + std::string(width - str.size(), ' ');
+    };
+
+    out << "nanoseconds per instruction, fastest of " << this->repeats << " runs\n";
+    out << pad("BENCHMARK", 16);
+    for (const engine& e : this->engines) out << pad(e.name, 12);
+    out << '\n';
+
+    std::vector<std::string> loopCosts(this->engines.size(), "-");
+    for (const benchmark& b : this->benchmarks) {
+        out << pad(b.name, 16);
+        for (size_t i = 0; i < this->engines.size(); ++i) {
+            const engine& e = this->engines[i];
+
+            // double the number of iterations until a run takes a noticeable time, then scale it to the requested time
+            uint64_t iterations = 16;
+            double time = this->measure(e, b, Microbenchmark::copies, iterations);
+            if (time < 0) {
+                out << pad("-", 12);
+                continue;
+            }
+            while (time < this->seconds / 8 && iterations * Microbenchmark::copies * 2 <= maxCopies) {
+                iterations *= 2;
+                time = e.run(createProgram(b, Microbenchmark::copies, iterations), b.isDispatchOnly);
+            }
+            if (time > 0) iterations = std::max<uint64_t>(1, std::min<uint64_t>(maxCopies / Microbenchmark::copies, static_cast<uint64_t>(static_cast<double>(iterations) * this->seconds / time)));
+
+            double loopTime = this->measure(e, b, 0, iterations);
+            time = this->measure(e, b, Microbenchmark::copies, iterations);
+            double instructions = static_cast<double>(iterations * Microbenchmark::copies * b.instructions);
+
+            std::ostringstream cost{};
+            cost.setf(std::ios::fixed);
+            cost.precision(2);
+            cost << (time - loopTime) * 1e9 / instructions;
+            out << pad(cost.str(), 12);
+
+            // the empty loop executes DEC, CMP and JNE once per iteration
+            std::ostringstream loopCost{};
+            loopCost.setf(std::ios::fixed);
+            loopCost.precision(2);
+            loopCost << loopTime * 1e9 / static_cast<double>(iterations * 3);
+            loopCosts[i] = loopCost.str();
+        }
+        out << '\n';
+    }
+
+    out << pad("loop", 16);
+    for (const std::string& cost : loopCosts) out << pad(cost, 12);
+    out << "\n(loop: DEC, CMP and JNE of the empty loop, measured with the last benchmark)\n";
+}
+
+// corpus benchmarks
+// measures the phases of real programs on every engine and compares them with a stored baseline
+class CorpusBenchmark
+{
+private:
+    struct program {
+        std::string name;
+        std::string code;
+        // initial register values of every run, from the optional "<name>.inputs" jobs file
+        std::vector<std::vector<std::pair<std::string, int>>> jobs;
+    };
+    struct result {
+        std::string program;
+        std::string engine;
+        std::string phase;
+        // seconds for all jobs of the program
+        double mean;
+        double deviation;
+        // instructions executed by all jobs, 0 for phases which do not run the program
+        uint64_t instructions;
+    };
+
+    std::vector<program> programs;
+    size_t runs;
+    uint64_t instructionLimit;
+
+    // measures all phases of a program, throws an error if a job fails the instruction limit
+    std::vector<result> measure(const program& p) const;
+    // measures the function `runs` times after a warm-up run
+    result summarize(const std::function<void()>& function) const;
+public:
+    // reads every "*.asm" file of a directory
+    CorpusBenchmark(const std::string& directory, size_t runs, uint64_t instructionLimit);
+
+    // `baselinePath` and `savePath` may be empty
+    void run(const std::string& baselinePath, const std::string& savePath, std::ostream& out);
+};
+
+CorpusBenchmark::CorpusBenchmark(const std::string& directory, size_t runs, uint64_t instructionLimit)
+{
+    this->runs = std::max<size_t>(runs, 2);
+    this->instructionLimit = instructionLimit;
+
+    std::error_code error{};
+    std::vector<std::filesystem::path> paths{};
+    for (const auto& entry : std::filesystem::directory_iterator(directory, error)) {
+        if (entry.is_regular_file() && entry.path().extension() == ".asm") paths.push_back(entry.path());
+    }
+    if (error) throw "ERROR::FILE::CAN_NOT_OPEN: " + directory;
+    std::sort(paths.begin(), paths.end());
+
+    for (const auto& path : paths) {
+        program p{path.filename().string(), readFile(path.string()), {}};
+        std::filesystem::path inputs = path;
+        inputs.replace_extension(".inputs");
+        if (std::filesystem::exists(inputs)) p.jobs = parseJobs(readFile(inputs.string()));
+        if (p.jobs.empty()) p.jobs.push_back({});
+        this->programs.push_back(std::move(p));
+    }
+}
+
+CorpusBenchmark::result CorpusBenchmark::summarize(const std::function<void()>& function) const
+{
+    function();
+
+    std::vector<double> times{};
+    for (size_t i = 0; i < this->runs; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        function();
+        times.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+
+    result r{};
+    for (double time : times) r.mean += time;
+    r.mean /= static_cast<double>(times.size());
+    for (double time : times) r.deviation += (time - r.mean) * (time - r.mean);
+    r.deviation = std::sqrt(r.deviation / static_cast<double>(times.size() - 1));
+    return r;
+}
+
+std::vector<CorpusBenchmark::result> CorpusBenchmark::measure(const program& p) const
+{
+    std::shared_ptr<const Bytecode> bytecode = std::make_shared<const Bytecode>(Interpreter::compile(p.code));
+    BytecodeEngine engine(bytecode);
+    engine.setInstructionLimit(this->instructionLimit);
+
+    // the instructions of a run do not change, so the first run checks the limit and counts them
+    uint64_t instructions = 0;
+    auto runJobs = [&]() -> void {
+        instructions = 0;
+        for (const auto& job : p.jobs) {
+            engine.reset();
+            for (const auto& reg : job) {
+                int slot = bytecode->findRegister(reg.first);
+                if (slot >= 0) engine.setRegister(slot, reg.second);
+            }
+            try {
+                engine.run();
+            } catch (const std::string& e) {
+                // runs which never end would make the reference interpreter hang
+                if (e.rfind("ERROR::INTERPRETER::INSTRUCTION_LIMIT_EXCEEDED", 0) == 0) throw;
+            }
+            instructions += engine.getExecutedInstructions();
+        }
+    };
+    runJobs();
+
+    std::vector<result> results{};
+    results.push_back(this->summarize([&]() { Interpreter::compile(p.code, false); }));
+    results.back().engine = "bytecode";
+    results.back().phase = "compile";
+    Bytecode unoptimized = Interpreter::compile(p.code, false);
+    // includes copying the bytecode, the pass changes it in place
+    results.push_back(this->summarize([&]() { Bytecode(unoptimized).optimize(); }));
+    results.back().engine = "bytecode";
+    results.back().phase = "optimize";
+    results.push_back(this->summarize(runJobs));
+    results.back().engine = "bytecode";
+    results.back().phase = "execute";
+    results.back().instructions = instructions;
+
+    // the same runs without the optimization pass
+    bytecode = std::make_shared<const Bytecode>(std::move(unoptimized));
+    engine = BytecodeEngine(bytecode);
+    engine.setInstructionLimit(this->instructionLimit);
+    results.push_back(this->summarize(runJobs));
+    results.back().engine = "unoptimized";
+    results.back().phase = "execute";
+    results.back().instructions = instructions;
+    results.push_back(this->summarize([&]() {
+        for (const auto& job : p.jobs) {
+            try {
+                Interpreter interpreter(p.code, job);
+            } catch (const std::string&) {
+            }
+        }
+    }));
+    results.back().engine = "reference";
+    results.back().phase = "parse+execute";
+    results.back().instructions = instructions;
+
+    for (result& r : results) r.program = p.name;
+    return results;
+}
+
+void CorpusBenchmark::run(const std::string& baselinePath, const std::string& savePath, std::ostream& out)
+{
+    // baseline lines: program, engine, phase, mean and deviation in seconds, separated by tabs
+    std::unordered_map<std::string, std::pair<double, double>> baseline{};
+    if (!baselinePath.empty()) {
+        std::stringstream ss(readFile(baselinePath));
+        std::string line = "";
+        while (std::getline(ss, line)) {
+            std::stringstream fields(line);
+            std::string name = "", engine = "", phase = "";
+            double mean = 0, deviation = 0;
+            if (!std::getline(fields, name, '\t') || !std::getline(fields, engine, '\t') || !std::getline(fields, phase, '\t') || !(fields >> mean >> deviation)) {
+                throw "ERROR::BASELINE::INVALID_LINE: " + line;
+            }
+            baseline[name + "\t" + engine + "\t" + phase] = {mean, deviation};
+        }
+    }
+
+    auto pad = [](const std::string& str, size_t width) -> std::string {
+        return str.size() >= width ? str + " " : str + std::string(width - str.size(), ' ');
+    };
+    auto format = [](double value, int precision) -> std::string {
+        std::ostringstream ss{};
+        ss.setf(std::ios::fixed);
+        ss.precision(precision);
+        ss << value;
+        return ss.str();
+    };
+
+    out << pad("PROGRAM", 20) << pad("ENGINE", 13) << pad("PHASE", 15) << pad("MEAN_US", 12) << pad("STDDEV_US", 11) << pad("INSTRUCTIONS/S", 16);
+    out << (baseline.empty() ? "\n" : "BASELINE\n");
+
+    // totals of every engine and phase: time, instructions, sum of logarithms of ratios to the baseline and their count
+    struct total {
+        double time;
+        uint64_t instructions;
+        double logRatios;
+        size_t ratios;
+    };
+    std::map<std::pair<std::string, std::string>, total> totals{};
+    std::vector<result> results{};
+
+    for (const program& p : this->programs) {
+        std::vector<result> programResults{};
+        try {
+            programResults = this->measure(p);
+        } catch (const std::string& e) {
+            out << pad(p.name, 20) << "skipped: " << e << '\n';
+            continue;
+        }
+
+        for (const result& r : programResults) {
+            out << pad(r.program, 20) << pad(r.engine, 13) << pad(r.phase, 15) << pad(format(r.mean * 1e6, 1), 12) << pad(format(r.deviation * 1e6, 1), 11);
+            out << pad(r.instructions ? format(static_cast<double>(r.instructions) / r.mean, 0) : "-", 16);
+
+            total& t = totals[{r.engine, r.phase}];
+            t.time += r.mean;
+            t.instructions += r.instructions;
+
+            auto it = baseline.find(r.program + "\t" + r.engine + "\t" + r.phase);
+            if (it != baseline.end() && it->second.first > 0) {
+                double change = r.mean / it->second.first - 1;
+                // a change is significant if it is larger than twice the combined deviation of both measurements
+                bool isSignificant = std::abs(r.mean - it->second.first) > 2 * std::sqrt(r.deviation * r.deviation + it->second.second * it->second.second);
+                out << (change >= 0 ? "+" : "") << format(change * 100, 1) << "%" << (isSignificant ? (change < 0 ? " faster" : " slower") : "");
+                t.logRatios += std::log(r.mean / it->second.first);
+                t.ratios++;
+            } else if (!baseline.empty()) {
+                out << "new";
+            }
+            out << '\n';
+            results.push_back(r);
+        }
+    }
+
+    out << '\n';
+    for (const auto& t : totals) {
+        out << pad("total", 20) << pad(t.first.first, 13) << pad(t.first.second, 15) << pad(format(t.second.time * 1e6, 1), 12) << pad("", 11);
+        out << pad(t.second.instructions ? format(static_cast<double>(t.second.instructions) / t.second.time, 0) : "-", 16);
+        if (t.second.ratios > 0) {
+            double change = std::exp(t.second.logRatios / static_cast<double>(t.second.ratios)) - 1;
+            out << (change >= 0 ? "+" : "") << format(change * 100, 1) << "% (geometric mean of " << t.second.ratios << " programs)";
+        }
+        out << '\n';
+    }
+
+    if (!savePath.empty()) {
+        std::ofstream file(savePath);
+        if (!file) throw "ERROR::FILE::CAN_NOT_OPEN: " + savePath;
+        file.precision(9);
+        for (const result& r : results) file << r.program << '\t' << r.engine << '\t' << r.phase << '\t' << r.mean << '\t' << r.deviation << '\n';
+    }
+}
+
+// differential testing
+// generates random programs and compares their results on the reference interpreter and every configuration of the bytecode engine
+class DifferentialTest
+{
+private:
+    typedef std::vector<std::pair<std::string, int>> inputs;
+
+    struct configuration {
+        std::string name;
+        // returns "OK <output>" or "ERR <error>"
+        std::function<std::string(const std::string& program, const inputs& registers)> run;
+    };
+
+    static const size_t maxDepth = 3;
+    // every program declares a memory of this many ints
+    static const int memorySize = 16;
+
+    std::mt19937_64 random;
+    std::vector<configuration> configurations;
+    uint64_t instructionLimit;
+    // registers changed by the generated instructions, loop counters get their own registers
+    std::vector<std::string> registers;
+    size_t labelCount;
+
+    int randomInt(int min, int max);
+    std::string randomRegister();
+    std::string randomOperand();
+    // mostly addresses inside the memory, sometimes outside or a register
+    std::string randomAddress();
+
+    std::string generateProgram();
+    // `scope` names the loop counters of the function, `firstCallable` is the first function the block may call
+    void generateBlock(std::vector<std::string>& lines, const std::string& scope, size_t depth, size_t firstCallable, size_t functionCount);
+    inputs generateInputs();
+
+    // returns a description of the first configuration whose result differs from the reference, or an empty string
+    std::string findDivergence(const std::string& program, const inputs& registers) const;
+    // removes lines and inputs while the program still diverges
+    void minimize(std::string& program, inputs& registers) const;
+public:
+    DifferentialTest(uint64_t seed, uint64_t instructionLimit);
+
+    // returns the number of diverging programs
+    size_t run(size_t count, std::ostream& out);
+};
+
+DifferentialTest::DifferentialTest(uint64_t seed, uint64_t instructionLimit)
+    : random(seed)
+{
+    this->instructionLimit = instructionLimit;
+    this->registers = {"a", "b", "c", "d", "e"};
+    this->labelCount = 0;
+
+    auto runEngine = [instructionLimit](std::shared_ptr<const Bytecode> bytecode, const inputs& registers, TraceRecorder* recorder) -> std::string {
+        BytecodeEngine engine(bytecode);
+        engine.setInstructionLimit(instructionLimit);
+        engine.setRecorder(recorder);
+        for (const auto& reg : registers) {
+            int slot = bytecode->findRegister(reg.first);
+            if (slot >= 0) engine.setRegister(slot, reg.second);
+        }
+        engine.run();
+        return "OK " + engine.getOutput();
+    };
+
+    this->configurations.push_back({"bytecode", [runEngine](const std::string& program, const inputs& registers) -> std::string {
+        return runEngine(std::make_shared<const Bytecode>(Interpreter::compile(program, false)), registers, nullptr);
+    }});
+    this->configurations.push_back({"bytecode (optimized)", [runEngine](const std::string& program, const inputs& registers) -> std::string {
+        return runEngine(std::make_shared<const Bytecode>(Interpreter::compile(program)), registers, nullptr);
+    }});
+    this->configurations.push_back({"bytecode (serialized)", [runEngine](const std::string& program, const inputs& registers) -> std::string {
+        std::string serialized = Interpreter::compile(program).serialize();
+        return runEngine(std::make_shared<const Bytecode>(Bytecode::deserialize(serialized)), registers, nullptr);
+    }});
+    this->configurations.push_back({"bytecode (recording)", [runEngine](const std::string& program, const inputs& registers) -> std::string {
+        TraceRecorder recorder{};
+        return runEngine(std::make_shared<const Bytecode>(Interpreter::compile(program)), registers, &recorder);
+    }});
+}
+
+int DifferentialTest::randomInt(int min, int max)
+{
+    return std::uniform_int_distribution<int>(min, max)(this->random);
+}
+
+std::string DifferentialTest::randomRegister()
+{
+    return this->registers[static_cast<size_t>(this->randomInt(0, static_cast<int>(this->registers.size()) - 1))];
+}
+
+std::string DifferentialTest::randomOperand()
+{
+    return this->randomInt(0, 1) ? this->randomRegister() : std::to_string(this->randomInt(-20, 20));
+}
+
+std::string DifferentialTest::randomAddress()
+{
+    int kind = this->randomInt(0, 9);
+    if (kind == 0) return this->randomRegister();
+    if (kind == 1) return std::to_string(this->randomInt(0, 1) ? -1 : DifferentialTest::memorySize);
+    return std::to_string(this->randomInt(0, DifferentialTest::memorySize - 1));
+}
+
+void DifferentialTest::generateBlock(std::vector<std::string>& lines, const std::string& scope, size_t depth, size_t firstCallable, size_t functionCount)
+{
+    static const std::vector<std::string> jumps{"jne", "je", "jge", "jg", "jle", "jl"};
+
+    auto label = [this]() -> std::string { return "l" + std::to_string(this->labelCount++); };
+    auto arithmetic = [this]() -> std::string {
+        std::string dst = this->randomRegister();
+        switch (this->randomInt(0, 12))
+        {
+        case 0: return "mov " + dst + ", " + this->randomOperand();
+        case 1: return "inc " + dst;
+        case 2: return "dec " + dst;
+        case 3: return "add " + dst + ", " + this->randomOperand();
+        case 4: return "sub " + dst + ", " + this->randomOperand();
+        // small factors keep values from overflowing quickly
+        case 5: return "mul " + dst + ", " + (this->randomInt(0, 3) ? std::to_string(this->randomInt(-3, 3)) : this->randomRegister());
+        case 6: return "and " + dst + ", " + this->randomOperand();
+        case 7: return "or " + dst + ", " + this->randomOperand();
+        case 8: return "xor " + dst + ", " + this->randomOperand();
+        case 9: return "not " + dst;
+        // counts outside 0..31 check that both engines take them modulo 32
+        case 10: return (this->randomInt(0, 1) ? "shl " : "shr ") + dst + ", " + (this->randomInt(0, 3) ? std::to_string(this->randomInt(-5, 40)) : this->randomRegister());
+        // division by a register may divide by zero, which both engines must report
+        case 11: return "mod " + dst + ", " + (this->randomInt(0, 3) ? std::to_string(this->randomInt(1, 5) * (this->randomInt(0, 1) ? 1 : -1)) : this->randomRegister());
+        default: return "div " + dst + ", " + (this->randomInt(0, 3) ? std::to_string(this->randomInt(1, 5) * (this->randomInt(0, 1) ? 1 : -1)) : this->randomRegister());
+        }
+    };
+
+    int statements = this->randomInt(1, static_cast<int>(6 - depth));
+    for (int i = 0; i < statements; ++i) {
+        int kind = this->randomInt(0, 99);
+        if ((kind < 20 || depth >= DifferentialTest::maxDepth) && this->randomInt(0, 30) == 0) {
+            // the smallest int divided by -1 overflows, both engines must wrap the quotient and give a remainder of 0
+            std::string dst = this->randomRegister();
+            lines.push_back("mov " + dst + ", 1");
+            lines.push_back("shl " + dst + ", 31");
+            lines.push_back((this->randomInt(0, 1) ? "div " : "mod ") + dst + ", " + (this->randomInt(0, 3) ? "-1" : this->randomRegister()));
+        } else if (kind < 20 || depth >= DifferentialTest::maxDepth) {
+            lines.push_back(arithmetic());
+        } else if (kind < 22) {
+            // a round trip through the task "w", which sends back a value computed from the one it receives
+            // the task waits forever if nothing is sent, which is a deadlock; channel 2 does not exist
+            std::string task = this->randomRegister();
+            lines.push_back("spawn " + task + ", w");
+            if (this->randomInt(0, 15)) lines.push_back("send " + std::string(this->randomInt(0, 30) ? "0" : "2") + ", " + this->randomOperand());
+            lines.push_back("recv " + this->randomRegister() + ", 1");
+            if (this->randomInt(0, 1)) lines.push_back("join " + (this->randomInt(0, 7) ? task : this->randomRegister()));
+        } else if (kind < 24) {
+            // native functions, sqrt does not exist and a few calls have one argument too many
+            static const std::vector<std::pair<std::string, int>> functions{{"abs", 1}, {"gcd", 2}, {"min", 3}, {"max", 2}, {"hash", 4}, {"sqrt", 1}};
+            std::string line = "syscall " + this->randomRegister() + ", ";
+            if (this->randomInt(0, 5) == 0) {
+                // a negative exponent is an error
+                line += "pow, " + this->randomOperand() + ", " + (this->randomInt(0, 7) ? std::to_string(this->randomInt(-1, 12)) : this->randomRegister());
+            } else {
+                const std::pair<std::string, int>& function = functions[static_cast<size_t>(this->randomInt(0, this->randomInt(0, 20) ? 4 : 5))];
+                line += function.first;
+                for (int count = function.second + (this->randomInt(0, 30) ? 0 : 1); count > 0; --count) line += ", " + this->randomOperand();
+            }
+            lines.push_back(line);
+        } else if (kind < 30) {
+            // a few vector registers, so instructions use each other's results; v16 does not exist
+            auto vectorRegister = [this]() -> std::string { return "v" + std::to_string(this->randomInt(0, 60) ? this->randomInt(0, 3) : 16); };
+            static const std::vector<std::string> lanewise{"vmov", "vadd", "vsub", "vmul", "vmin", "vmax", "vcmpeq", "vcmpgt"};
+            static const std::vector<std::string> reductions{"vhsum", "vhmin", "vhmax"};
+            std::string address = this->randomInt(0, 3) ? std::to_string(this->randomInt(0, DifferentialTest::memorySize - 8)) : this->randomAddress();
+            switch (this->randomInt(0, 4))
+            {
+            case 0:
+            case 1: lines.push_back(lanewise[static_cast<size_t>(this->randomInt(0, 7))] + " " + vectorRegister() + ", " + vectorRegister()); break;
+            case 2: lines.push_back("vset " + vectorRegister() + ", " + this->randomOperand()); break;
+            case 3: lines.push_back(reductions[static_cast<size_t>(this->randomInt(0, 2))] + " " + this->randomRegister() + ", " + vectorRegister()); break;
+            default: lines.push_back(this->randomInt(0, 1) ? "vload " + vectorRegister() + ", " + address : "vstore " + address + ", " + vectorRegister()); break;
+            }
+        } else if (kind < 34) {
+            switch (this->randomInt(0, 4))
+            {
+            case 0: lines.push_back("load " + this->randomRegister() + ", " + this->randomAddress()); break;
+            case 1: lines.push_back("load " + this->randomRegister() + ", " + std::to_string(this->randomInt(0, 8)) + ", " + this->randomAddress()); break;
+            case 2: lines.push_back("store " + this->randomAddress() + ", " + this->randomOperand()); break;
+            case 3: lines.push_back("memset " + this->randomAddress() + ", " + this->randomOperand() + ", " + std::to_string(this->randomInt(-1, 8))); break;
+            default: lines.push_back("memcpy " + this->randomAddress() + ", " + this->randomAddress() + ", " + std::to_string(this->randomInt(0, 8))); break;
+            }
+        } else if (kind < 40) {
+            // conditional moves, and the jumps over moves which the optimizer converts into them
+            static const std::vector<std::string> moves{"cmovne", "cmove", "cmovge", "cmovg", "cmovle", "cmovl"};
+            size_t condition = static_cast<size_t>(this->randomInt(0, 5));
+            std::string dst = this->randomRegister();
+            lines.push_back("cmp " + this->randomOperand() + ", " + this->randomOperand());
+            int form = this->randomInt(0, 2);
+            if (form == 0) {
+                lines.push_back(moves[condition] + " " + dst + ", " + this->randomOperand());
+            } else if (form == 1) {
+                std::string skip = label();
+                lines.push_back(jumps[condition] + " " + skip);
+                lines.push_back("mov " + dst + ", " + this->randomOperand());
+                lines.push_back(skip + ":");
+            } else {
+                std::string otherwise = label();
+                std::string end = label();
+                lines.push_back(jumps[condition] + " " + otherwise);
+                lines.push_back("mov " + dst + ", " + this->randomOperand());
+                lines.push_back("jmp " + end);
+                lines.push_back(otherwise + ":");
+                lines.push_back("mov " + dst + ", " + this->randomOperand());
+                lines.push_back(end + ":");
+            }
+        } else if (kind < 52) {
+            // if
+            std::string skip = label();
+            if (this->randomInt(0, 3)) {
+                lines.push_back("cmp " + this->randomRegister() + ", " + this->randomOperand());
+                lines.push_back(jumps[static_cast<size_t>(this->randomInt(0, 5))] + " " + skip);
+            } else {
+                lines.push_back((this->randomInt(0, 1) ? "jz " : "jnz ") + this->randomRegister() + ", " + skip);
+            }
+            this->generateBlock(lines, scope, depth + 1, firstCallable, functionCount);
+            lines.push_back(skip + ":");
+        } else if (kind < 58) {
+            // if ... else
+            std::string otherwise = label();
+            std::string end = label();
+            lines.push_back("cmp " + this->randomOperand() + ", " + this->randomOperand());
+            lines.push_back(jumps[static_cast<size_t>(this->randomInt(0, 5))] + " " + otherwise);
+            this->generateBlock(lines, scope, depth + 1, firstCallable, functionCount);
+            lines.push_back("jmp " + end);
+            lines.push_back(otherwise + ":");
+            this->generateBlock(lines, scope, depth + 1, firstCallable, functionCount);
+            lines.push_back(end + ":");
+        } else if (kind < 62) {
+            // switch, the index is often out of range, which runs the default case
+            std::string index = this->randomRegister();
+            if (this->randomInt(0, 1)) lines.push_back("and " + index + ", 3");
+            std::string end = label();
+            std::vector<std::string> cases{};
+            std::string table = "jtab " + index;
+            for (int i = this->randomInt(1, 3); i > 0; --i) {
+                cases.push_back(label());
+                // the same case may be listed twice
+                table += ", " + (this->randomInt(0, 4) ? cases.back() : cases.front());
+            }
+            lines.push_back(table);
+            this->generateBlock(lines, scope, depth + 1, firstCallable, functionCount);
+            lines.push_back("jmp " + end);
+            for (const std::string& c : cases) {
+                lines.push_back(c + ":");
+                this->generateBlock(lines, scope, depth + 1, firstCallable, functionCount);
+                // cases may fall through into the next one
+                if (this->randomInt(0, 3)) lines.push_back("jmp " + end);
+            }
+            lines.push_back(end + ":");
+        } else if (kind < 74) {
+            // bounded loop, its counter is not changed by the body or by called functions
+            std::string counter = "k" + scope + std::string(1, static_cast<char>('a' + depth));
+            std::string start = label();
+            int iterations = this->randomInt(1, 5);
+            int form = this->randomInt(0, 3);
+            lines.push_back("mov " + counter + ", " + (form == 0 ? "0" : std::to_string(iterations)));
+            lines.push_back(start + ":");
+            this->generateBlock(lines, scope, depth + 1, firstCallable, functionCount);
+            if (form == 0) {
+                lines.push_back("inc " + counter);
+                lines.push_back("cmp " + counter + ", " + std::to_string(iterations));
+                lines.push_back((this->randomInt(0, 1) ? "jl " : "jne ") + start);
+            } else if (form == 1) {
+                lines.push_back("dec " + counter);
+                lines.push_back("cmp " + counter + ", 0");
+                lines.push_back((this->randomInt(0, 1) ? "jg " : "jne ") + start);
+            } else if (form == 2) {
+                // counts down to a value other than 0, fused by the optimizer
+                lines.push_back("add " + counter + ", 2");
+                lines.push_back("dec " + counter);
+                lines.push_back("cmp " + counter + ", 2");
+                lines.push_back("jne " + start);
+            } else {
+                lines.push_back(this->randomInt(0, 1) ? "loop " + counter + ", " + start : "dec " + counter + "\njnz " + counter + ", " + start);
+            }
+        } else if (kind < 84) {
+            // functions call only functions defined after them, so there is no recursion
+            if (firstCallable < functionCount) lines.push_back("call f" + std::to_string(this->randomInt(static_cast<int>(firstCallable), static_cast<int>(functionCount) - 1)));
+        } else if (kind < 87) {
+            lines.push_back("msg '" + this->randomRegister() + " = ', " + this->randomRegister());
+        } else if (kind < 90) {
+            // registers saved around a block, sometimes a single PUSH or POP which leaves the stack unbalanced
+            std::string saved = this->randomRegister();
+            for (int i = this->randomInt(0, 2); i > 0; --i) saved += ", " + this->randomRegister();
+            int form = this->randomInt(0, 9);
+            if (form == 0) {
+                lines.push_back("push " + this->randomOperand());
+            } else if (form == 1) {
+                lines.push_back("pop " + saved);
+            } else {
+                lines.push_back("push " + saved);
+                this->generateBlock(lines, scope, depth + 1, firstCallable, functionCount);
+                lines.push_back("pop " + saved);
+            }
+        } else if (kind < 95) {
+            // the result of CMP is used by a later jump
+            lines.push_back("cmp " + this->randomOperand() + ", " + this->randomRegister());
+        } else {
+            // dead code
+            std::string skip = label();
+            lines.push_back("jmp " + skip);
+            lines.push_back(arithmetic());
+            lines.push_back(skip + ":");
+        }
+    }
+}
+
+std::string DifferentialTest::generateProgram()
+{
+    this->labelCount = 0;
+    size_t functionCount = static_cast<size_t>(this->randomInt(0, 3));
+    std::vector<std::string> lines{};
+
+    lines.push_back(".memory " + std::to_string(DifferentialTest::memorySize));
+    lines.push_back(".channel 1");
+    lines.push_back(".channel 1");
+    if (this->randomInt(0, 3)) {
+        std::string data = ".data " + std::to_string(this->randomInt(0, 8));
+        for (int i = this->randomInt(1, 8); i > 0; --i) data += ", " + std::to_string(this->randomInt(-50, 50));
+        lines.push_back(data);
+    }
+    // vector registers start with different lanes
+    for (int v = 0; v < 4; ++v) lines.push_back("vload v" + std::to_string(v) + ", " + std::to_string(this->randomInt(0, DifferentialTest::memorySize - 8)));
+    this->generateBlock(lines, "m", 0, 0, functionCount);
+    // a hash of the memory is part of the message, so every change of the memory is compared
+    std::vector<std::string> hash{"mov hi, 0", "mov h, 0", "hash:", "load hv, hi", "mul h, 31", "add h, hv", "inc hi", "cmp hi, " + std::to_string(DifferentialTest::memorySize), "jl hash"};
+    for (int v = 0; v < 4; ++v) {
+        for (const char* reduction : {"vhsum", "vhmin", "vhmax"}) {
+            hash.push_back(std::string(reduction) + " hv, v" + std::to_string(v));
+            hash.push_back("mul h, 31");
+            hash.push_back("add h, hv");
+        }
+    }
+    lines.insert(lines.end(), hash.begin(), hash.end());
+    std::string message = "msg ";
+    for (size_t i = 0; i < this->registers.size(); ++i) message += (i ? ", ' " : "'") + this->registers[i] + "=', " + this->registers[i];
+    lines.push_back(message + ", ' memory=', h");
+    lines.push_back("end");
+
+    for (size_t f = 0; f < functionCount; ++f) {
+        lines.push_back("f" + std::to_string(f) + ":");
+        this->generateBlock(lines, std::string(1, static_cast<char>('a' + f)), 0, f + 1, functionCount);
+        lines.push_back("ret");
+    }
+
+    // the task of round trips, it changes only its own copies of the registers and the memory
+    lines.push_back("w:");
+    lines.push_back("recv w, 0");
+    for (int i = this->randomInt(1, 3); i > 0; --i) {
+        static const std::vector<std::string> operations{"add", "sub", "xor", "mul"};
+        lines.push_back(operations[static_cast<size_t>(this->randomInt(0, 3))] + " w, " + this->randomOperand());
+        if (this->randomInt(0, 1)) lines.push_back(this->randomInt(0, 1) ? "store " + this->randomAddress() + ", w" : "div w, " + this->randomRegister());
+    }
+    lines.push_back("send 1, w");
+    lines.push_back("end");
+
+    std::string program = "";
+    for (const std::string& line : lines) program += line + "\n";
+    return program;
+}
+
+DifferentialTest::inputs DifferentialTest::generateInputs()
+{
+    inputs result{};
+    for (const std::string& reg : this->registers) {
+        if (this->randomInt(0, 1)) result.push_back({reg, this->randomInt(-50, 50)});
+    }
+    return result;
+}
+
+std::string DifferentialTest::findDivergence(const std::string& program, const inputs& registers) const
+{
+    auto result = [&](const std::function<std::string()>& run) -> std::string {
+        try {
+            return run();
+        } catch (const std::string& e) {
+            return "ERR " + e;
+        }
+    };
+
+    std::string expected = result([&]() { return "OK " + Interpreter(program, registers, this->instructionLimit).getOutput(); });
+    for (const configuration& c : this->configurations) {
+        std::string actual = result([&]() { return c.run(program, registers); });
+        if (actual != expected) return "reference: " + expected + "\n" + c.name + ": " + actual;
+    }
+    return "";
+}
+
+void DifferentialTest::minimize(std::string& program, inputs& registers) const
+{
+    // This function removes chunks of lines, starting with large ones, as long as the program still diverges.
+
+    std::vector<std::string> lines{};
+    std::stringstream ss(program);
+    std::string line = "";
+    while (std::getline(ss, line)) lines.push_back(line);
+
+    auto join = [](const std::vector<std::string>& l) -> std::string {
+        std::string result = "";
+        for (const std::string& s : l) result += s + "\n";
+        return result;
+    };
+
+    for (size_t chunk = std::max<size_t>(lines.size() / 2, 1); chunk > 0; chunk /= 2) {
+        for (size_t start = 0; start < lines.size();) {
+            std::vector<std::string> candidate(lines.begin(), lines.begin() + static_cast<std::ptrdiff_t>(start));
+            candidate.insert(candidate.end(), lines.begin() + static_cast<std::ptrdiff_t>(std::min(start + chunk, lines.size())), lines.end());
+            if (!this->findDivergence(join(candidate), registers).empty()) {
+                lines = candidate;
+            } else {
+                start += chunk;
+            }
+        }
+    }
+    program = join(lines);
+
+    for (size_t i = 0; i < registers.size();) {
+        inputs candidate = registers;
+        candidate.erase(candidate.begin() + static_cast<std::ptrdiff_t>(i));
+        if (!this->findDivergence(program, candidate).empty()) {
+            registers = candidate;
+        } else {
+            ++i;
+        }
+    }
+}
+
+size_t DifferentialTest::run(size_t count, std::ostream& out)
+{
+    // only the first diverging programs are minimized and printed
+    const size_t maxReported = 3;
+
+    size_t diverged = 0;
+    for (size_t i = 0; i < count; ++i) {
+        std::string program = this->generateProgram();
+        inputs registers = this->generateInputs();
+        if (this->findDivergence(program, registers).empty()) continue;
+
+        if (diverged++ < maxReported) {
+            this->minimize(program, registers);
+            out << "program " << i << " diverges\n" << this->findDivergence(program, registers) << "\ninputs:";
+            for (const auto& reg : registers) out << ' ' << reg.first << '=' << reg.second;
+            out << "\nminimized program:\n" << program << '\n';
+        }
+    }
+
+    out << count << " programs, " << diverged << " diverged (configurations: reference";
+    for (const configuration& c : this->configurations) out << ", " << c.name;
+    out << ")\n";
+    return diverged;
+}
+
+// thread scaling
+void runScalingBenchmark(const std::string& program, const std::vector<std::vector<std::pair<std::string, int>>>& jobs, size_t maxThreads, double seconds, std::ostream& out)
+{
+    // This function runs the same batch of requests on a worker pool with 1, 2, 4, ... threads, the way the daemon runs them:
+    // every request looks the program up in the shared program cache and runs it on its own engine.
+    // The submitting thread keeps two requests per thread in flight, so latencies are not dominated by a long queue.
+
+    const size_t maxRequests = 2000000;
+
+    std::vector<std::vector<std::pair<std::string, int>>> workload = jobs;
+    if (workload.empty()) workload.push_back({});
+
+    auto runRequest = [&program](ProgramCache& cache, const std::vector<std::pair<std::string, int>>& job, uint64_t& cacheTime) -> void {
+        auto start = std::chrono::steady_clock::now();
+        std::shared_ptr<const Bytecode> bytecode = cache.get(program);
+        cacheTime = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+
+        BytecodeEngine engine(bytecode);
+        for (const auto& reg : job) {
+            int slot = bytecode->findRegister(reg.first);
+            if (slot >= 0) engine.setRegister(slot, reg.second);
+        }
+        try {
+            engine.run();
+        } catch (const std::string&) {
+        }
     };
-    auto trim = [&](const std::string& str) -> std::string { return rtrim(ltrim(str)); };
 
-    while (std::getline(l_program, line)) {
-        // remove everything after first ';' (crop comments)
-        line = [&](std::string& str) -> std::string {
-            size_t pos = str.find(';');
-            return pos == std::string::npos ? str : str.substr(0, pos);
-        }(line);
-        // remove whitespaces at the beginning and at the end of the string
-        line = trim(line);
+    // the number of requests is chosen so that a single thread needs about the given time
+    size_t requests = 0;
+    {
+        ProgramCache cache(1);
+        uint64_t cacheTime = 0;
+        auto start = std::chrono::steady_clock::now();
+        double elapsed = 0;
+        while (elapsed < seconds / 10 && requests < maxRequests) {
+            runRequest(cache, workload[requests % workload.size()], cacheTime);
+            requests++;
+            elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+        requests = std::min(maxRequests, std::max(workload.size(), static_cast<size_t>(static_cast<double>(requests) * 10)));
+    }
 
-        // ignore empty lines
-        if (line.length() == 0) continue;
-        
-        std::stringstream ss(line);
-        std::string type = "";
-        ss >> type;
+    auto pad = [](const std::string& str, size_t width) -> std::string {
+        return str.size() >= width ? str + " " : str + std::string(width - str.size(), ' ');
+    };
+    auto format = [](double value, int precision) -> std::string {
+        std::ostringstream ss{};
+        ss.setf(std::ios::fixed);
+        ss.precision(precision);
+        ss << value;
+        return ss.str();
+    };
 
-        InstructionType instructionType = InstructionType::NONE;
+    out << requests << " requests per measurement, " << std::thread::hardware_concurrency() << " cores\n";
+    out << pad("THREADS", 9) << pad("REQUESTS/S", 13) << pad("SPEEDUP", 9) << pad("EFFICIENCY", 12) << pad("P50_US", 10) << pad("P99_US", 10)
+        << pad("P999_US", 10) << pad("SUBMIT_US", 11) << pad("QUEUE_US", 10) << pad("CACHE_US", 10) << "CACHE_P99_US\n";
 
-        // check if the current instruction is a label
-        if (type.length() > 1 && type.back() == ':') {
-            std::string subroutine = type.substr(0, type.length() - 1);
-            // set the position of the subroutine
-            this->subroutines[subroutine] = this->instructions.size();
-            continue;
-        }
+    std::vector<size_t> threadCounts{};
+    for (size_t t = 1; t < maxThreads; t *= 2) threadCounts.push_back(t);
+    threadCounts.push_back(std::max<size_t>(maxThreads, 1));
 
-        // a map which allows to convert string into enum (InstructionType)
-        std::unordered_map<std::string, InstructionType> instructionTypeMap{
-            { "mov", InstructionType::MOV },
-            { "inc", InstructionType::INC },
-            { "dec", InstructionType::DEC },
-            { "add", InstructionType::ADD },
-            { "sub", InstructionType::SUB },
-            { "mul", InstructionType::MUL },
-            { "div", InstructionType::DIV },
-            { "jmp", InstructionType::JMP },
-            { "cmp", InstructionType::CMP },
-            { "jne", InstructionType::JNE },
-            { "je", InstructionType::JE },
-            { "jge", InstructionType::JGE },
-            { "jg", InstructionType::JG },
-            { "jle", InstructionType::JLE },
-            { "jl", InstructionType::JL },
-            { "call", InstructionType::CALL },
-            { "msg", InstructionType::MSG },
-            { "ret", InstructionType::RET },
-            { "end", InstructionType::END }
-        };
+    double singleThreadThroughput = 0;
+    for (size_t threads : threadCounts) {
+        ProgramCache cache(16);
+        // every request writes only its own entries, the submitting thread reads them after the pool finished
+        std::vector<uint64_t> latencies(requests, 0);
+        std::vector<uint64_t> queueTimes(requests, 0);
+        std::vector<uint64_t> cacheTimes(requests, 0);
+        uint64_t submitTime = 0;
 
-        // assigns the corresponding InstructionType based on the input string 'type'
-        auto it = instructionTypeMap.find(type);
-        if (it != instructionTypeMap.end()) {
-            instructionType = it->second;
-        } else {
-            throw "ERROR::INTERPRETER::UNKOWN_INSTRUCTION_TYPE: " + type;
-        }
-        
-        // parse args
-        std::vector<std::string> args{};
-        std::string arg = "";
+        std::mutex mutex{};
+        std::condition_variable condition{};
+        size_t inFlight = 0;
+        const size_t maxInFlight = 2 * threads;
 
-        if (instructionType == InstructionType::MSG) {
-            // msg instruction args are parsed differently, because they may include queted text
-            bool insideQuote = false;
-            
-            for (char c : ss.str().substr(ss.tellg())) {
-                // ingore leading whitespaces the first character is found 
-                if (c == ' ' && arg.length() == 0) continue;
-                // track if an arg is a text between apostrophes
-                if (c == '\'') insideQuote = !insideQuote;
-                // a comma indicates the end of the current argument, but only if it is outside quoted text
-                else if (c == ',' && !insideQuote) {
-                    args.push_back(arg);
-                    arg = "";
-                    continue;
+        auto start = std::chrono::steady_clock::now();
+        {
+            WorkerPool pool(threads);
+            for (size_t i = 0; i < requests; ++i) {
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    condition.wait(lock, [&]() { return inFlight < maxInFlight; });
+                    inFlight++;
                 }
-                arg += c;
-            }
-            // add the final arg to the list
-            if (arg.length() > 0) args.push_back(arg);
-        } else {
-            // all other isntruction types
-            while (ss >> arg) {
-                // remove ',' from the end of the arg if exists
-                arg = arg.back() == ',' ? arg.substr(0, arg.length() - 1) : arg;
-                args.push_back(arg);
+
+                auto submitted = std::chrono::steady_clock::now();
+                pool.submit([&, i, submitted]() {
+                    auto started = std::chrono::steady_clock::now();
+                    runRequest(cache, workload[i % workload.size()], cacheTimes[i]);
+                    auto finished = std::chrono::steady_clock::now();
+                    queueTimes[i] = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(started - submitted).count());
+                    latencies[i] = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(finished - submitted).count());
+                    {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        inFlight--;
+                    }
+                    condition.notify_one();
+                });
+                submitTime += static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - submitted).count());
             }
         }
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
 
-        // store the parsed instruciton
-        this->instructions.push_back(Interpreter::instruction{instructionType, args});
+        auto mean = [](const std::vector<uint64_t>& values) -> double {
+            double sum = 0;
+            for (uint64_t value : values) sum += static_cast<double>(value);
+            return sum / static_cast<double>(values.size());
+        };
+        auto percentile = [](std::vector<uint64_t>& values, double fraction) -> double {
+            size_t index = std::min(values.size() - 1, static_cast<size_t>(fraction * static_cast<double>(values.size())));
+            std::nth_element(values.begin(), values.begin() + static_cast<std::ptrdiff_t>(index), values.end());
+            return static_cast<double>(values[index]);
+        };
+
+        double throughput = static_cast<double>(requests) / elapsed;
+        if (threads == 1) singleThreadThroughput = throughput;
+        double speedup = throughput / singleThreadThroughput;
+
+        out << pad(std::to_string(threads), 9) << pad(format(throughput, 0), 13) << pad(format(speedup, 2), 9) << pad(format(100 * speedup / static_cast<double>(threads), 1) + "%", 12)
+            << pad(format(percentile(latencies, 0.5) / 1000, 1), 10) << pad(format(percentile(latencies, 0.99) / 1000, 1), 10) << pad(format(percentile(latencies, 0.999) / 1000, 1), 10)
+            << pad(format(static_cast<double>(submitTime) / static_cast<double>(requests) / 1000, 2), 11) << pad(format(mean(queueTimes) / 1000, 1), 10)
+            << pad(format(mean(cacheTimes) / 1000, 2), 10) << format(percentile(cacheTimes, 0.99) / 1000, 2) << '\n';
     }
 }
 
-void Interpreter::execute()
+int runCommandLine(const std::vector<std::string>& args)
 {
-    size_t instructionPointer = 0;
-    std::stack<size_t> call_stack{};
+    // This function handles non-interactive modes selected by command line arguments.
 
-    bool isFinished = false;
+    auto printUsage = []() -> void {
+        std::cerr
+        << "Usage:\n"
+        << "\tAssemblerInterpreter\t\t\t\t\tStart the interactive mode\n"
+        << "\tAssemblerInterpreter --trace [file] [mode...]\t\t\tRun another mode and write its Chrome trace-event JSON to a file\n"
+        << "\tAssemblerInterpreter --metrics [file] [mode...]\t\tRun another mode and write its metrics in the Prometheus text format to a file\n"
+        << "\tAssemblerInterpreter --coordinator [port] [program] [jobs] [options]\tDistribute jobs of a program to workers\n"
+        << "\t\t--max-instructions [n]\tFail jobs which execute more instructions (default: 100000000)\n"
+        << "\t\t--timeout [s]\t\tRun a job on another worker if its worker does not finish it in time (default: 60)\n"
+        << "\tAssemblerInterpreter --worker [host] [port]\t\t\tRun jobs received from a coordinator\n"
+        << "\tAssemblerInterpreter --sweep [program] [ranges] [options]\tRun a program for every combination of register values\n"
+        << "\t\tranges: name=first..last or name=first..last:step\n"
+        << "\t\t--where [predicate]\tPrint only runs whose final registers match, e.g. \"c==5 && b>a\"\n"
+        << "\t\t--limit [k]\t\tStop after the first k matches\n"
+        << "\t\t--reduce [reduction]\tAggregate matches instead of printing them: count, sum:reg, min:reg, max:reg, hist:reg:width\n"
+        << "\t\t--threads [n]\t\tNumber of threads (default: number of cores)\n"
+        << "\tAssemblerInterpreter --batch [program] [input] [output] [registers] [options]\n"
+        << "\t\t\t\t\t\t\tRun a program for every row of a column file, store final registers in another column file\n"
+        << "\t\t--reduce [reduction]\tAlso aggregate final registers of runs which did not fail, as in --sweep\n"
+        << "\t\t--threads [n]\t\tNumber of threads (default: number of cores)\n"
+        << "\tAssemblerInterpreter --import-csv [csv] [output]\t\tConvert a CSV file into a column file\n"
+        << "\tAssemblerInterpreter --export-csv [input]\t\tPrint a column file as CSV\n"
+        << "\tAssemblerInterpreter --daemon [socket] [options]\t\tRun programs received over a local socket\n"
+        << "\t\t--threads [n]\t\tNumber of threads running programs (default: number of cores)\n"
+        << "\t\t--max-instructions [n]\tFail runs which execute more instructions (default: 100000000)\n"
+        << "\tAssemblerInterpreter --daemon-check [socket]\t\t\tCheck that a running daemon survives requests which fail or never end\n"
+        << "\tAssemblerInterpreter --profile [program] [name=value ...] [options]\n"
+        << "\t\t\t\t\t\t\tRun a program repeatedly and print samples of its labels\n"
+        << "\t\t\t\t\t\t\t(code entered by falling through a label counts for the last jump target)\n"
+        << "\t\t--seconds [s]\t\tHow long to run the program (default: 1)\n"
+        << "\t\t--hz [n]\t\tSamples per second of CPU time (default: 1000)\n"
+        << "\t\t--folded\t\tPrint call stacks in the folded format of flame graph tools\n"
+        << "\tAssemblerInterpreter --record [program] [jobs] [trace]\t\tRun every job of a program and record its control flow into a trace file\n"
+        << "\tAssemblerInterpreter --replay [trace] [--profile]\t\tRun recorded runs again and report runs which diverge from the trace\n"
+        << "\t\t--profile\t\tPrint executed instructions of every label reconstructed from the trace instead\n"
+        << "\tAssemblerInterpreter --microbench [options]\t\t\tMeasure the cost of every instruction on every engine\n"
+        << "\t\t--seconds [s]\t\tApproximate time of a single measurement (default: 0.05)\n"
+        << "\t\t--repeat [n]\t\tNumber of measurements, the fastest is used (default: 5)\n"
+        << "\t\t--filter [text]\t\tRun only benchmarks whose name contains the text\n"
+        << "\tAssemblerInterpreter --corpus-bench [directory] [options]\tMeasure the phases of every program of a directory on every engine\n"
+        << "\t\t--runs [n]\t\tNumber of measurements of every phase (default: 10)\n"
+        << "\t\t--baseline [file]\tCompare the results with a stored baseline\n"
+        << "\t\t--save-baseline [file]\tStore the results as a baseline\n"
+        << "\t\t--max-instructions [n]\tSkip programs whose runs execute more instructions (default: 100000000)\n"
+        << "\tAssemblerInterpreter --difftest [options]\t\t\tCompare random programs on the reference interpreter and every engine configuration\n"
+        << "\t\t--count [n]\t\tNumber of programs (default: 1000)\n"
+        << "\t\t--seed [n]\t\tSeed of the generator (default: random, printed)\n"
+        << "\t\t--max-instructions [n]\tInstruction limit of every run (default: 1000000)\n"
+        << "\tAssemblerInterpreter --scaling-bench [program] [jobs] [options]\tRun the jobs of a program on 1, 2, 4, ... worker threads\n"
+        << "\t\t--max-threads [n]\tLargest number of threads (default: number of cores)\n"
+        << "\t\t--seconds [s]\t\tApproximate time of the single thread measurement (default: 1)\n";
+    };
+    auto toCount = [](const std::string& str) -> unsigned long long {
+        if (str.empty() || str.find_first_not_of("0123456789") != std::string::npos) throw "ERROR::COMMAND_LINE::INVALID_NUMBER: " + str;
+        return std::stoull(str);
+    };
 
-    while (!isFinished) {
-        // check if the program is finished
-        if (instructionPointer >= this->instructions.size()) {
-            isFinished = true;
-            continue;
-        }
+    try {
+        if (args[0] == "--trace" && args.size() >= 3) {
+            std::ofstream file(args[1]);
+            if (!file) throw "ERROR::FILE::CAN_NOT_OPEN: " + args[1];
+            TraceBuffer::start();
+            int result = runCommandLine(std::vector<std::string>(args.begin() + 2, args.end()));
+            TraceBuffer::stop();
+            TraceBuffer::write(file);
+            return result;
+        } else if (args[0] == "--metrics" && args.size() >= 3) {
+            std::ofstream file(args[1]);
+            if (!file) throw "ERROR::FILE::CAN_NOT_OPEN: " + args[1];
+            isMetricsEnabled = true;
+            int result = runCommandLine(std::vector<std::string>(args.begin() + 2, args.end()));
+            metrics.write(file);
+            return result;
+        } else if (args[0] == "--coordinator" && args.size() >= 4) {
+#ifndef _WIN32
+            uint64_t instructionLimit = 100000000;
+            unsigned long long timeout = 60;
+            for (size_t i = 4; i < args.size(); ++i) {
+                if (i + 1 >= args.size()) throw "ERROR::COMMAND_LINE::MISSING_VALUE: " + args[i];
+                if (args[i] == "--max-instructions") instructionLimit = toCount(args[++i]);
+                else if (args[i] == "--timeout") timeout = toCount(args[++i]);
+                else throw "ERROR::COMMAND_LINE::UNKNOWN_OPTION: " + args[i];
+            }
 
-        Interpreter::instruction& instr = this->instructions[instructionPointer++];
+            signal(SIGPIPE, SIG_IGN);
+            int port = std::stoi(args[1]);
+            if (port <= 0 || port > 65535) throw "ERROR::COORDINATOR::INVALID_PORT: " + args[1];
+            Coordinator coordinator(Interpreter::compile(readFile(args[2])), parseJobs(readFile(args[3])), instructionLimit,
+                                    std::chrono::seconds(static_cast<long long>(std::min<unsigned long long>(timeout, 1ULL << 31))));
+            coordinator.run(static_cast<unsigned short>(port), std::cout);
+            return 0;
+#endif
+        } else if (args[0] == "--worker" && args.size() == 3) {
+#ifndef _WIN32
+            signal(SIGPIPE, SIG_IGN);
+            runWorker(args[1], args[2]);
+            return 0;
+#endif
+        } else if (args[0] == "--sweep" && args.size() >= 2) {
+            std::vector<std::string> ranges{};
+            std::string predicate = "";
+            std::vector<std::string> reductions{};
+            unsigned long long limit = 0;
+            size_t threads = std::max(1u, std::thread::hardware_concurrency());
 
-        auto validateArgCount = [&](const size_t desiredSize) -> void {
-            if (instr.args.size() != desiredSize) throw "ERROR::INTERPRETER::INVALID_NUMBER_OF_ARGS: " + std::to_string(instr.args.size());
-        };
-        auto validateFirstArgIsRegister = [&]() -> void {
-            if (!this->isRegister(instr.args[0])) throw "ERROR::INTERPRETER::FIRST_ARG_SHOULD_BE_A_REGISTER: " + instr.args[0];
-        };
-        auto validateArgs = [&](const size_t desiredSize) -> void {
-            validateArgCount(desiredSize);
-            validateFirstArgIsRegister();
-        };
-        auto resolveValue = [&](const std::string& arg) -> int {
-            int val = 0;
-            if (this->isRegister(arg)) {
-                val = this->regs[arg];
-            } else if (this->isConst(arg)) {
-                val = std::stoi(arg);
-            } else {
-                throw "ERROR::INTERPRETER::INVALID_ARG: " + arg;
+            for (size_t i = 2; i < args.size(); ++i) {
+                if (args[i].compare(0, 2, "--") != 0) {
+                    ranges.push_back(args[i]);
+                    continue;
+                }
+                if (i + 1 >= args.size()) throw "ERROR::COMMAND_LINE::MISSING_VALUE: " + args[i];
+                if (args[i] == "--where") predicate = args[++i];
+                else if (args[i] == "--limit") limit = toCount(args[++i]);
+                else if (args[i] == "--reduce") reductions.push_back(args[++i]);
+                else if (args[i] == "--threads") threads = static_cast<size_t>(toCount(args[++i]));
+                else throw "ERROR::COMMAND_LINE::UNKNOWN_OPTION: " + args[i];
             }
-            return val;
-        };
-        auto findSubroutine = [&](const std::string& name) -> size_t {
-            auto it = this->subroutines.find(name);
-            if (it == this->subroutines.end()) {
-                throw "ERROR::INTERPRETER::CAN_NOT_FIND_SUBROUTINE: " + name;
+
+            Sweep sweep(std::make_shared<const Bytecode>(Interpreter::compile(readFile(args[1]))), ranges, predicate, reductions);
+            sweep.run(threads, limit, std::cout);
+            return 0;
+        } else if (args[0] == "--batch" && args.size() >= 4) {
+            std::vector<std::string> registers{};
+            std::vector<std::string> reductions{};
+            size_t threads = std::max(1u, std::thread::hardware_concurrency());
+            for (size_t i = 4; i < args.size(); ++i) {
+                if (args[i] == "--threads" && i + 1 < args.size()) threads = static_cast<size_t>(toCount(args[++i]));
+                else if (args[i] == "--reduce" && i + 1 < args.size()) reductions.push_back(args[++i]);
+                else registers.push_back(args[i]);
             }
-            return it->second;
-        };
-        
-        switch (instr.type)
-        {
-        case InstructionType::MOV:
-            validateArgs(2);
-            this->regs[instr.args[0]] = resolveValue(instr.args[1]);
-            break;
-        case InstructionType::INC:
-            validateArgs(1);
-            this->regs[instr.args[0]]++;
-            break;
-        case InstructionType::DEC:
-            validateArgs(1);
-            this->regs[instr.args[0]]--;
-            break;
-        case InstructionType::ADD:
-            validateArgs(2);
-            this->regs[instr.args[0]] += resolveValue(instr.args[1]);
-            break;
-        case InstructionType::SUB:
-            validateArgs(2);
-            this->regs[instr.args[0]] -= resolveValue(instr.args[1]);
-            break;
-        case InstructionType::MUL:
-            validateArgs(2);
-            this->regs[instr.args[0]] *= resolveValue(instr.args[1]); 
-            break;
-        case InstructionType::DIV:
-            validateArgs(2);
-            this->regs[instr.args[0]] /= resolveValue(instr.args[1]);
-            break;
-        case InstructionType::JMP:
-            validateArgCount(1);
-            instructionPointer = findSubroutine(instr.args[0]);
-            continue;
-        case InstructionType::CMP:
-            validateArgCount(2);
-            this-> cmpResult = resolveValue(instr.args[0]) - resolveValue(instr.args[1]);
-            break;
-        case InstructionType::JNE:
-            validateArgCount(1);
-            if (this->cmpResult != 0) {
-                instructionPointer = findSubroutine(instr.args[0]);
+            runColumnBatch(std::make_shared<const Bytecode>(Interpreter::compile(readFile(args[1]))), args[2], args[3], registers, reductions, threads, std::cout);
+            return 0;
+        } else if (args[0] == "--daemon" && args.size() >= 2) {
+#ifdef __linux__
+            size_t threads = std::max(1u, std::thread::hardware_concurrency());
+            // any client can send a program which never ends, without a limit it would occupy a thread forever
+            uint64_t instructionLimit = 100000000;
+            for (size_t i = 2; i < args.size(); ++i) {
+                if (i + 1 >= args.size()) throw "ERROR::COMMAND_LINE::MISSING_VALUE: " + args[i];
+                if (args[i] == "--threads") threads = static_cast<size_t>(toCount(args[++i]));
+                else if (args[i] == "--max-instructions") instructionLimit = toCount(args[++i]);
+                else throw "ERROR::COMMAND_LINE::UNKNOWN_OPTION: " + args[i];
             }
-            continue;
-        case InstructionType::JE:
-            validateArgCount(1);
-            if (this->cmpResult == 0) {
-                instructionPointer = findSubroutine(instr.args[0]);
+
+            struct sigaction action{};
+            action.sa_handler = [](int) { isServerStopping = 1; };
+            sigaction(SIGINT, &action, nullptr);
+            sigaction(SIGTERM, &action, nullptr);
+            signal(SIGPIPE, SIG_IGN);
+
+            isMetricsEnabled = true;
+            Server server(args[1], threads, instructionLimit);
+            std::cerr << "Listening on " << args[1] << '\n';
+            server.run();
+            return 0;
+#endif
+        } else if (args[0] == "--daemon-check" && args.size() == 2) {
+#ifdef __linux__
+            signal(SIGPIPE, SIG_IGN);
+            return checkDaemon(args[1], std::cout) == 0 ? 0 : 1;
+#endif
+        } else if (args[0] == "--profile" && args.size() >= 2) {
+            std::string inputs = "";
+            double seconds = 1;
+            int frequency = 1000;
+            bool isFolded = false;
+            for (size_t i = 2; i < args.size(); ++i) {
+                if (args[i].compare(0, 2, "--") != 0) {
+                    inputs += args[i] + " ";
+                    continue;
+                }
+                if (args[i] == "--folded") {
+                    isFolded = true;
+                    continue;
+                }
+                if (i + 1 >= args.size()) throw "ERROR::COMMAND_LINE::MISSING_VALUE: " + args[i];
+                if (args[i] == "--seconds") seconds = std::stod(args[++i]);
+                else if (args[i] == "--hz") frequency = static_cast<int>(toCount(args[++i]));
+                else throw "ERROR::COMMAND_LINE::UNKNOWN_OPTION: " + args[i];
             }
-            continue;
-        case InstructionType::JGE:
-            validateArgCount(1);
-            if (this->cmpResult >= 0) {
-                instructionPointer = findSubroutine(instr.args[0]);
+            profileProgram(readFile(args[1]), parseRegisterValues(inputs), seconds, frequency, isFolded, std::cout);
+            return 0;
+        } else if (args[0] == "--record" && args.size() == 4) {
+            recordTrace(readFile(args[1]), parseJobs(readFile(args[2])), args[3], std::cout);
+            return 0;
+        } else if (args[0] == "--replay" && args.size() == 3 && args[2] == "--profile") {
+            profileTrace(args[1], std::cout);
+            return 0;
+        } else if (args[0] == "--replay" && args.size() == 2) {
+            return replayTrace(args[1], std::cout) ? 0 : 1;
+        } else if (args[0] == "--microbench") {
+            double seconds = 0.05;
+            size_t repeats = 5;
+            std::string filter = "";
+            for (size_t i = 1; i < args.size(); ++i) {
+                if (i + 1 >= args.size()) throw "ERROR::COMMAND_LINE::MISSING_VALUE: " + args[i];
+                if (args[i] == "--seconds") seconds = std::stod(args[++i]);
+                else if (args[i] == "--repeat") repeats = static_cast<size_t>(toCount(args[++i]));
+                else if (args[i] == "--filter") filter = args[++i];
+                else throw "ERROR::COMMAND_LINE::UNKNOWN_OPTION: " + args[i];
             }
-            continue;
-        case InstructionType::JG:
-            validateArgCount(1);
-            if (this->cmpResult > 0) {
-                instructionPointer = findSubroutine(instr.args[0]);
+            Microbenchmark microbenchmark(seconds, repeats, filter);
+            microbenchmark.run(std::cout);
+            return 0;
+        } else if (args[0] == "--corpus-bench" && args.size() >= 2) {
+            size_t runs = 10;
+            uint64_t instructionLimit = 100000000;
+            std::string baselinePath = "";
+            std::string savePath = "";
+            for (size_t i = 2; i < args.size(); ++i) {
+                if (i + 1 >= args.size()) throw "ERROR::COMMAND_LINE::MISSING_VALUE: " + args[i];
+                if (args[i] == "--runs") runs = static_cast<size_t>(toCount(args[++i]));
+                else if (args[i] == "--baseline") baselinePath = args[++i];
+                else if (args[i] == "--save-baseline") savePath = args[++i];
+                else if (args[i] == "--max-instructions") instructionLimit = toCount(args[++i]);
+                else throw "ERROR::COMMAND_LINE::UNKNOWN_OPTION: " + args[i];
             }
-            continue;
-        case InstructionType::JLE:
-            validateArgCount(1);
-            if (this->cmpResult <= 0) {
-                instructionPointer = findSubroutine(instr.args[0]);
+            CorpusBenchmark benchmark(args[1], runs, instructionLimit);
+            benchmark.run(baselinePath, savePath, std::cout);
+            return 0;
+        } else if (args[0] == "--difftest") {
+            size_t count = 1000;
+            uint64_t seed = std::random_device{}();
+            uint64_t instructionLimit = 1000000;
+            for (size_t i = 1; i < args.size(); ++i) {
+                if (i + 1 >= args.size()) throw "ERROR::COMMAND_LINE::MISSING_VALUE: " + args[i];
+                if (args[i] == "--count") count = static_cast<size_t>(toCount(args[++i]));
+                else if (args[i] == "--seed") seed = toCount(args[++i]);
+                else if (args[i] == "--max-instructions") instructionLimit = toCount(args[++i]);
+                else throw "ERROR::COMMAND_LINE::UNKNOWN_OPTION: " + args[i];
             }
-            continue;
-        case InstructionType::JL:
-            validateArgCount(1);
-            if (this->cmpResult < 0) {
-                instructionPointer = findSubroutine(instr.args[0]);
+            std::cout << "seed " << seed << '\n';
+            DifferentialTest test(seed, instructionLimit);
+            return test.run(count, std::cout) == 0 ? 0 : 1;
+        } else if (args[0] == "--scaling-bench" && args.size() >= 3) {
+            size_t maxThreads = std::max(1u, std::thread::hardware_concurrency());
+            double seconds = 1;
+            for (size_t i = 3; i < args.size(); ++i) {
+                if (i + 1 >= args.size()) throw "ERROR::COMMAND_LINE::MISSING_VALUE: " + args[i];
+                if (args[i] == "--max-threads") maxThreads = static_cast<size_t>(toCount(args[++i]));
+                else if (args[i] == "--seconds") seconds = std::stod(args[++i]);
+                else throw "ERROR::COMMAND_LINE::UNKNOWN_OPTION: " + args[i];
             }
-            continue;
-        case InstructionType::CALL:
-            validateArgCount(1);
-            call_stack.push(instructionPointer);
-            instructionPointer = findSubroutine(instr.args[0]);
-            break;
-        case InstructionType::MSG:
-            this->messagePattern = instr.args;
-            break;
-        case InstructionType::RET:
-            instructionPointer = call_stack.top();
-            call_stack.pop();
-            break;
-        case InstructionType::END:
-            this->createMessage();
-            isFinished = true;
-            break;
-        default:
-            break;
-        }
-    }
-}
-
-void Interpreter::createMessage()
-{
-    if (this->messagePattern.empty()) {
-        // default output
-        this->output = "-1";
-        return;
-    }
-
-    this->output = "";
-    for (std::string a : this->messagePattern) {
-        if (a.at(0) == '\'') {
-            // quoted text
-            this->output += a.substr(1, a.length() - 2);
-        } else if (this->isRegister(a)) {
-            // register value
-            this->output += std::to_string(this->regs[a]);
+            runScalingBenchmark(readFile(args[1]), parseJobs(readFile(args[2])), maxThreads, seconds, std::cout);
+            return 0;
+        } else if (args[0] == "--import-csv" && args.size() == 3) {
+            importCsv(args[1], args[2]);
+            return 0;
+        } else if (args[0] == "--export-csv" && args.size() == 2) {
+            exportCsv(args[1], std::cout);
+            return 0;
         } else {
-            throw "ERROR::INTERPRETER::INVALID_MSG_ARGUMENT: " + a;
+            printUsage();
+            return 1;
         }
+    } catch (const std::string& e) {
+        std::cerr << e << std::endl;
+        return 1;
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
     }
-}
-
-// constructor
-Interpreter::Interpreter (const std::string& program)
-    : program(program)
-{
-    this->initVariables();
-    this->parseProgram();
-    this->execute();
-}
-
-// accessors
-const std::string& Interpreter::getOutput() const {
-    return this->output;
-};
 
-std::string assembler_interpreter(std::string program) {
-    Interpreter interpreter(program);
-    return interpreter.getOutput();
+    std::cerr << args[0] << ": not supported on this platform\n";
+    return 1;
 }
 
-int main ()
+int main (int argc, char* argv[])
 {
+    if (argc > 1) return runCommandLine(std::vector<std::string>(argv + 1, argv + argc));
+
     struct program {
         std::string id;
         std::string desc;
@@ -578,7 +7551,67 @@ continue:
 
 print:
     msg a, '^', b, ' = ', c
-    ret)"}
+    ret)"}, {"#8", "GCD and power with native functions", R"(
+mov     a, 81         ; value1
+mov     b, 153        ; value2
+syscall c, gcd, a, b
+syscall d, pow, 2, 10
+msg     'gcd(', a, ', ', b, ') = ', c, ', 2^10 = ', d
+end)"}, {"#9", "Parallel sum of squares with tasks", R"(
+.channel 4            ; results of the tasks
+mov   n, 4            ; number of tasks
+mov   k, n
+mov   i, 0            ; index of the next task
+start:
+    spawn t, square_sum
+    inc   i
+    loop  k, start
+mov   k, n
+mov   s, 0
+collect:
+    recv  v, 0
+    add   s, v
+    loop  k, collect
+msg   'sum of squares of 1..1000 = ', s
+end
+
+; every task sums the squares of the numbers of its quarter
+square_sum:
+    mov   a, i
+    mul   a, 250
+    mov   j, 250
+    mov   r, 0
+next:
+    inc   a
+    mov   b, a
+    mul   b, a
+    add   r, b
+    loop  j, next
+    send  0, r
+    end)"}, {"#10", "Sum of absolute differences with macros", R"(
+; macros are expanded while parsing, so they cost no CALL and RET
+%macro absdiff dst, x, y
+    mov   dst, x
+    sub   dst, y
+    cmp   dst, 0
+    jge   %%done          ; %% makes the label local to every use
+    not   dst
+    inc   dst
+%%done:
+%endm
+
+%macro accumulate x, y
+    absdiff d, x, y
+    add   s, d
+%endm
+
+mov   s, 0
+accumulate 3, 10
+accumulate 10, 3
+accumulate -5, 5
+accumulate 42, 42
+msg   'sum of absolute differences = ', s
+end)"}
     };
 
     auto toLowerCase = [](std::string& str) -> void {
@@ -616,6 +7649,8 @@ print:
             << "\tlist\t\tList programs\n"
             << "\tshow [id]\tShow a program code\n"
             << "\trun [id]\tRun a program\n"
+            << "\tbench [id] [n]\tParse and run a program n times (default: 1000), print timings\n"
+            << "\tprofile [id]\tRun a program repeatedly for a second, print samples of its labels\n"
             << "\texit\t\tExit the program\n";
         } else if (command == "exit") {
             break;
@@ -657,6 +7692,41 @@ print:
             } else {
                 std::cout << "The argument ID is required\n";
             }
+        } else if (command == "bench") {
+            if (ss >> arg) {
+                const program* p = findProgram(arg);
+                size_t runs = 1000;
+                std::string count = "";
+                if (!p) {
+                    std::cout << "Invalid ID: " + arg + "\n";
+                } else if (ss >> count && (count.find_first_not_of("0123456789") != std::string::npos || count.length() > 9)) {
+                    std::cout << "Invalid number of runs: " + count + "\n";
+                } else {
+                    if (!count.empty()) runs = std::stoul(count);
+                    try {
+                        benchProgram(p->code, runs, std::cout);
+                    } catch (const std::string& e) {
+                        std::cout << e << std::endl;
+                    }
+                }
+            } else {
+                std::cout << "The argument ID is required\n";
+            }
+        } else if (command == "profile") {
+            if (ss >> arg) {
+                const program* p = findProgram(arg);
+                if (p) {
+                    try {
+                        profileProgram(p->code, {}, 1, 1000, false, std::cout);
+                    } catch (const std::string& e) {
+                        std::cout << e << std::endl;
+                    }
+                } else {
+                    std::cout << "Invalid ID: " + arg + "\n";
+                }
+            } else {
+                std::cout << "The argument ID is required\n";
+            }
         } else {
             std::cout << command << ": command not found\nType \"help\" or ? to see available commands\n";
         }